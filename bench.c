@@ -0,0 +1,1442 @@
+// Benchmarks for the simplex solver.
+// Build with: cc -O2 bench.c -o bench -lm
+#define SIMPLEX_NO_MAIN
+#include "simplex.c"
+
+// State of the pseudo random generator (xorshift64), fixed so runs are reproducible.
+unsigned long long rng_state = 88172645463325252ULL;
+
+// Get a pseudo random value in [0, 1).
+double rnd() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (rng_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Create a dense feasible dictionary with 'n' variables and 'n' constraints.
+dictionary random_dic(int n) {
+
+    vector c = vec(n);
+    vector b = vec(n);
+    triplets t = trip(n * n);
+    for (int i = 0; i < n; i++) {
+        c.data[i] = 1.0 + rnd();
+        b.data[i] = 1.0 + 100.0 * rnd();
+        for (int j = 0; j < n; j++)
+            trip_add(&t, i, j, 0.1 + rnd());
+    }
+    spmatrix a = sp_from_triplets(n, n, &t);
+
+    dictionary d = create_dic(&c, &b, &a, 0, 0, 0);
+    freetrip(&t);
+    freevec(&c);
+    freevec(&b);
+    freesp(&a);
+    return d;
+
+}
+
+// Time 'count' pivots on a dense 'n' x 'n' dictionary.
+void bench_pivot(int n, int count) {
+
+    dictionary d = random_dic(n);
+
+    int e, l, done = 0;
+    double total = 0, search = 0;
+    while (done < count) {
+        double start = now();
+        int state = find_pivot(&d, &e, &l);
+        search += now() - start;
+        if (state != SIMPLEX_STATE_FEASIBLE)
+            break;
+        start = now();
+        d = pivot(d, e, l);
+        total += now() - start;
+        done++;
+    }
+
+    printf("pivot %ix%i (%i threads): %i pivots in %.3f s (%.3f ms/pivot, %.3f ms/find_pivot)\n", n, n, pool.threads, done, total,
+        done ? 1000.0 * total / done : 0.0, done ? 1000.0 * search / done : 0.0);
+
+    freedic(&d);
+
+}
+
+// Compare every available row kernel against the scalar reference.
+// Returns the number of mismatches.
+int check_kernels(int n, int count) {
+
+    const char* names[] = { "sse2", "avx2" };
+    int failures = 0;
+
+    for (int k = 0; k < 2; k++) {
+
+        if (!select_kernel(names[k])) {
+            printf("kernel %s: not supported, skipped\n", names[k]);
+            continue;
+        }
+        row_kernel kernel = row_update;
+
+        // Single row updates over every length and start offset to cover the remainder loops
+        double row[67], ref[67], prow[67];
+        for (int len = 0; len <= 64; len++) {
+            for (int off = 0; off < 3; off++) {
+                double f = rnd() * 4.0 - 2.0;
+                for (int j = 0; j < len; j++) {
+                    ref[off + j] = row[off + j] = rnd() * 10.0 - 5.0;
+                    prow[off + j] = rnd() * 10.0 - 5.0;
+                }
+                row_update_scalar(ref + off, prow + off, f, len);
+                kernel(row + off, prow + off, f, len);
+                for (int j = 0; j < len; j++)
+                    if (fabs(row[off + j] - ref[off + j]) > 1e-12 * (1.0 + fabs(ref[off + j])))
+                        failures++;
+            }
+        }
+
+        // Whole pivot sequences on the same dictionary with both kernels
+        unsigned long long seed = rng_state;
+        dictionary a = random_dic(n);
+        rng_state = seed;
+        dictionary b = random_dic(n);
+        double maxDiff = 0;
+        int e, l;
+        for (int p = 0; p < count; p++) {
+            if (find_pivot(&a, &e, &l) != SIMPLEX_STATE_FEASIBLE)
+                break;
+            row_update = row_update_scalar;
+            a = pivot(a, e, l);
+            row_update = kernel;
+            b = pivot(b, e, l);
+        }
+        for (int i = 0; i < a.dic.rows; i++)
+            for (int j = 0; j < a.dic.columns; j++) {
+                double d = fabs(mat_row(&a.dic, i)[j] - mat_row(&b.dic, i)[j]);
+                double m = 1.0 + fabs(mat_row(&a.dic, i)[j]);
+                maxDiff = d / m > maxDiff ? d / m : maxDiff;
+            }
+        if (maxDiff > 1e-9)
+            failures++;
+        printf("kernel %s: max relative difference after pivots %g\n", names[k], maxDiff);
+        freedic(&a);
+        freedic(&b);
+
+    }
+
+    select_kernel("auto");
+    return failures;
+
+}
+
+// Create a random problem with 'm' constraints on 'n' variables (about a third of A nonzero, a third
+// of those negative). The first row has every variable with a positive coefficient so the problem is
+// bounded, one in fifty bounds is zero, and rows and columns are scaled by up to 'scale' orders of magnitude.
+void random_lp(int n, int m, double scale, vector* c, vector* b, spmatrix* a) {
+    *c = vec(n);
+    *b = vec(m);
+    double* colScale = (double*)malloc(sizeof(double) * n);
+    for (int j = 0; j < n; j++) {
+        colScale[j] = pow(10.0, scale * (rnd() - 0.5));
+        c->data[j] = (1.0 + 9.0 * rnd()) * colScale[j];
+    }
+    triplets t = trip(n * m / 3 + 1);
+    for (int i = 0; i < m; i++) {
+        double rowScale = pow(10.0, scale * (rnd() - 0.5));
+        b->data[i] = rnd() < 0.02 ? 0 : (1.0 + 99.0 * rnd()) * rowScale;
+        for (int j = 0; j < n; j++)
+            if (i == 0 || rnd() < 1.0 / 3.0 || j == i % n)
+                trip_add(&t, i, j, (i == 0 || rnd() < 0.7 ? 0.1 + rnd() : -rnd()) * rowScale / colScale[j]);
+    }
+    *a = sp_from_triplets(m, n, &t);
+    freetrip(&t);
+    free(colScale);
+}
+
+// Solve 'count' random 'n' x 'n' problems with every pricing rule and compare iterations and time.
+void bench_pricing(int n, int count, double scale) {
+
+    const char* names[] = { "dantzig", "devex", "steepest" };
+    printf("%-10s %10s %10s %12s %10s %14s\n", "pricing", "problems", "optimal", "iterations", "time (s)", "objective sum");
+    writer out = wr(0, VERBOSITY_QUIET);
+    for (int k = 0; k < 3; k++) {
+        select_pricing(names[k]);
+        rng_state = 88172645463325252ULL;
+        long iterations = 0;
+        double total = 0, objective = 0;
+        int optimal = 0;
+        for (int p = 0; p < count; p++) {
+            vector c, b;
+            spmatrix a;
+            random_lp(n, n, scale, &c, &b, &a);
+            double start = now();
+            dictionary d = simplex(&c, &b, &a, 0, 0, 0, &out);
+            total += now() - start;
+            iterations += d.iterations;
+            if (d.state == SIMPLEX_STATE_SUCCESS) {
+                objective += mat_row(&d.dic, 0)[0];
+                optimal++;
+            }
+            freedic(&d);
+            freevec(&c);
+            freevec(&b);
+            freesp(&a);
+        }
+        printf("%-10s %10i %10i %12li %10.3f %14.6g\n", names[k], count, optimal, iterations, total, objective);
+    }
+    freewr(&out);
+    select_pricing("dantzig");
+
+}
+
+// Re-solve a random 'n' x 'n' problem 'count' times after small changes to the objective and then to
+// the bounds, from scratch and with reoptimize on the previous dictionary.
+void bench_warm(int n, int count) {
+
+    vector c, b;
+    spmatrix a;
+    random_lp(n, n, 0, &c, &b, &a);
+    writer out = wr(0, VERBOSITY_QUIET);
+    dictionary warm = simplex(&c, &b, &a, 0, 0, 0, &out);
+    vector c2 = vec(n), b2 = vec(n);
+    memcpy(c2.data, c.data, sizeof(double) * n);
+    memcpy(b2.data, b.data, sizeof(double) * n);
+
+    printf("%-10s %8s %14s %14s %14s %14s\n", "change", "solves", "cold pivots", "cold ms", "warm pivots", "warm ms");
+    for (int k = 0; k < 2; k++) {
+        long coldPivots = 0, warmPivots = 0;
+        double coldTime = 0, warmTime = 0, maxDiff = 0;
+        for (int p = 0; p < count; p++) {
+            vector* changed = k == 0 ? &c2 : &b2;
+            vector* base = k == 0 ? &c : &b;
+            for (int i = 0; i < n; i++)
+                changed->data[i] = base->data[i] * (1.0 + 0.1 * (rnd() - 0.5));
+
+            double start = now();
+            dictionary cold = simplex(&c2, &b2, &a, 0, 0, 0, &out);
+            coldTime += now() - start;
+            coldPivots += cold.iterations;
+
+            start = now();
+            int before = warm.iterations;
+            warm = reoptimize(warm, &c2, &b2, &a, 0, 0);
+            warmTime += now() - start;
+            warmPivots += warm.iterations - before;
+
+            double diff = fabs(mat_row(&cold.dic, 0)[0] - mat_row(&warm.dic, 0)[0]);
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+            freedic(&cold);
+        }
+        printf("%-10s %8i %14.1f %14.3f %14.1f %14.3f  (max objective difference %g)\n", k == 0 ? "objective" : "bounds", count,
+            (double)coldPivots / count, 1000.0 * coldTime / count, (double)warmPivots / count, 1000.0 * warmTime / count, maxDiff);
+    }
+
+    freedic(&warm);
+    freewr(&out);
+    freevec(&c);
+    freevec(&b);
+    freevec(&c2);
+    freevec(&b2);
+    freesp(&a);
+
+}
+
+// Infeasible starts: random problems where a 'share' of the rows are >= constraints (negative bounds),
+// solved through the auxiliary problem, the dual simplex method and the automatic choice. With 'cost'
+// the objective is negated (minimize a positive cost), which makes the initial dictionary dual feasible.
+void bench_method(int n, int count, double share, int cost) {
+
+    const char* names[] = { "auxiliary", "dual", "auto" };
+    int methods[] = { METHOD_PRIMAL, METHOD_DUAL, METHOD_AUTO };
+    printf("%-10s %8s %10s %14s %12s %12s\n", "method", "problems", "solved", "mean pivots", "mean ms", "mismatches");
+    double objective[count];
+    for (int k = 0; k < 3; k++) {
+        simplex_method = methods[k];
+        rng_state = 12345;
+        long pivots = 0;
+        double time = 0;
+        int solved = 0, mismatches = 0;
+        for (int p = 0; p < count; p++) {
+            vector c, b;
+            spmatrix a;
+            random_lp(n, n, 0, &c, &b, &a);
+            for (int i = 0; i < n; i++) {
+                if (rnd() < share) {
+                    // Turn row i around: sum a_ij x_j >= b_i / 2
+                    for (int j = 0; j < n; j++)
+                        for (int e = a.start[j]; e < a.start[j + 1]; e++)
+                            if (a.index[e] == i)
+                                a.value[e] = -a.value[e];
+                    b.data[i] = -0.5 * b.data[i];
+                }
+            }
+            for (int j = 0; j < n && cost; j++)
+                c.data[j] = -c.data[j];
+            writer out = wr(0, VERBOSITY_QUIET);
+            double start = now();
+            dictionary d = simplex(&c, &b, &a, 0, 0, 0, &out);
+            time += now() - start;
+            pivots += d.iterations;
+            double value = d.state == SIMPLEX_STATE_SUCCESS ? mat_row(&d.dic, 0)[0] : NAN;
+            solved += d.state == SIMPLEX_STATE_SUCCESS;
+            if (k == 0)
+                objective[p] = value;
+            else if (!(fabs(value - objective[p]) <= 1e-6 * (1 + fabs(value))) && !(isnan(value) && isnan(objective[p])))
+                mismatches++;
+            freedic(&d);
+            freewr(&out);
+            freevec(&c);
+            freevec(&b);
+            freesp(&a);
+        }
+        printf("%-10s %8i %10i %14.1f %12.3f %12i\n", names[k], count, solved,
+            (double)pivots / count, 1000.0 * time / count, mismatches);
+    }
+    simplex_method = METHOD_AUTO;
+
+}
+
+// Create a random problem in solver form with 'n' variables and 'n' constraints (see random_lp) plus
+// reductions for presolve: 'n' / 4 singleton rows (upper bounds), 'n' / 8 scaled copies of rows with a
+// looser bound, 'n' / 8 variables fixed at zero by equality rows, 'n' / 8 dominated columns (negative cost and
+// no negative entries) and 'n' / 16 empty rows.
+linprog redundant_lp(int n) {
+    vector c, b;
+    spmatrix a;
+    random_lp(n, n, 0, &c, &b, &a);
+    int m = n + n / 4 + n / 8 + n / 8 + n / 16;
+    linprog p;
+    p.vars = n;
+    p.max = 1;
+    p.c = c;
+    p.b = vec(m);
+    p.sense = (signed char*)malloc(m);
+    p.lower = 0;
+    p.upper = 0;
+    p.file.data = 0;
+    p.scen.count = 0;
+    memset(p.sense, SENSE_LE, m);
+    memcpy(p.b.data, b.data, sizeof(double) * n);
+    triplets t = trip(a.nnz * 2 + m);
+    for (int j = 0; j < n; j++)
+        for (int k = a.start[j]; k < a.start[j + 1]; k++)
+            trip_add(&t, a.index[k], j, a.value[k]);
+    int i = n;
+    for (int k = 0; k < n / 4; k++, i++) {
+        trip_add(&t, i, (int)(rnd() * n), 1.0);
+        p.b.data[i] = 1.0 + 10.0 * rnd();
+    }
+    for (int k = 0; k < n / 8; k++, i++) {
+        int row = (int)(rnd() * n);
+        for (int j = 0; j < n; j++)
+            for (int e = a.start[j]; e < a.start[j + 1]; e++)
+                if (a.index[e] == row)
+                    trip_add(&t, i, j, 2.0 * a.value[e]);
+        p.b.data[i] = 2.0 * b.data[row] + 1.0;
+    }
+    for (int k = 0; k < n / 8; k++, i++) {
+        trip_add(&t, i, (int)(rnd() * n), 1.0);
+        p.b.data[i] = 0; // Keeps x = 0 feasible
+        p.sense[i] = SENSE_EQ;
+    }
+    for (int k = 0; k < n / 8; k++) { // The first triplets are the entries of A in column order
+        int j = (int)(rnd() * n);
+        p.c.data[j] = -fabs(p.c.data[j]);
+        for (int e = a.start[j]; e < a.start[j + 1]; e++)
+            t.value[e] = fabs(t.value[e]);
+    }
+    for (; i < m; i++)
+        p.b.data[i] = 1.0 + rnd();
+    p.a = sp_from_triplets(m, n, &t);
+    freetrip(&t);
+    freevec(&b);
+    freesp(&a);
+    return p;
+}
+
+// Solve 'count' problems from redundant_lp with and without presolve (with the revised engine if 'revised'
+// is set), and compare the time both take (presolve included) and the rows and columns presolve removes.
+void bench_presolve(int n, int count, int revised) {
+
+    writer out = wr(0, VERBOSITY_QUIET);
+    long pivots[2] = { 0, 0 }, rows = 0, columns = 0, removedRows = 0, removedColumns = 0;
+    double time[2] = { 0, 0 }, presolveTime = 0, maxDiff = 0;
+    for (int p = 0; p < count; p++) {
+        linprog prog = redundant_lp(n);
+
+        double start = now();
+        dictionary full = revised ? revised_simplex(&prog.c, &prog.b, &prog.a, prog.sense, 0, 0, 0, &out)
+                                  : simplex(&prog.c, &prog.b, &prog.a, prog.sense, 0, 0, &out);
+        time[0] += now() - start;
+        pivots[0] += full.iterations;
+
+        start = now();
+        postsolve post;
+        linprog r = presolve(&prog, &post);
+        var_bounds vb = { r.lower, r.upper };
+        dictionary reduced = revised ? revised_simplex(&r.c, &r.b, &r.a, r.sense, r.lower ? &vb : 0, 0, 0, &out)
+                                     : simplex(&r.c, &r.b, &r.a, r.sense, r.lower ? &vb : 0, 0, &out);
+        time[1] += now() - start;
+        pivots[1] += reduced.iterations;
+        presolveTime += post.time;
+
+        rows += post.rows;
+        columns += post.columns;
+        removedRows += post.rows - post.keptRows;
+        removedColumns += post.count;
+        if (full.state != reduced.state) {
+            maxDiff = INFINITY;
+        } else if (full.state == SIMPLEX_STATE_SUCCESS) {
+            double diff = fabs(mat_row(&full.dic, 0)[0] - mat_row(&reduced.dic, 0)[0] - post.offset);
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+        }
+        freedic(&full);
+        freedic(&reduced);
+        freepost(&post);
+        freelp(&r);
+        freelp(&prog);
+    }
+
+    printf("%i problems, %.1f rows and %.1f columns on average, presolve removed %.1f rows and %.1f columns in %.3f ms\n", count,
+        (double)rows / count, (double)columns / count, (double)removedRows / count, (double)removedColumns / count, 1000.0 * presolveTime / count);
+    printf("%-10s %14s %14s\n", "presolve", "mean pivots", "mean ms");
+    for (int k = 0; k < 2; k++)
+        printf("%-10s %14.1f %14.3f\n", k == 0 ? "off" : "on", (double)pivots[k] / count, 1000.0 * time[k] / count);
+    printf("time saved: %.1f%% (max objective difference %g)\n", 100.0 * (time[0] - time[1]) / time[0], maxDiff);
+    freewr(&out);
+
+}
+
+// Get the largest violation of Ax <= b and x >= 0 (relative to the size of the bound) by the solution of a
+// solved dictionary of the problem.
+double residual(dictionary* d, vector* b, spmatrix* a) {
+    double* x = (double*)calloc(d->varc > 0 ? d->varc : 1, sizeof(double));
+    for (int i = 1; i < d->dic.rows; i++) {
+        int v = d->vars[d->varc - 1 + i];
+        if (v <= d->varc)
+            x[v - 1] = solution_value(d, v, mat_row(&d->dic, i)[0]);
+    }
+    double worst = 0;
+    for (int j = 0; j < d->varc; j++)
+        worst = fmax(worst, -x[j]);
+    double* ax = (double*)calloc(b->size > 0 ? b->size : 1, sizeof(double));
+    for (int j = 0; j < a->columns; j++)
+        for (int k = a->start[j]; k < a->start[j + 1]; k++)
+            ax[a->index[k]] += a->value[k] * x[j];
+    for (int i = 0; i < b->size; i++)
+        worst = fmax(worst, (ax[i] - b->data[i]) / (1 + fabs(b->data[i])));
+    free(x);
+    free(ax);
+    return worst;
+}
+
+// Solve 'count' random 'n' x 'n' problems whose rows and columns are scaled by up to 'orders' orders of
+// magnitude with and without scaling, and compare iterations, time and the accuracy of the solutions.
+void bench_scaling(int n, int count, double orders, int revised) {
+
+    writer out = wr(0, VERBOSITY_QUIET);
+    long pivots[2] = { 0, 0 };
+    double time[2] = { 0, 0 }, worst[2] = { 0, 0 }, before = 0, after = 0, passes = 0, maxDiff = 0;
+    int solved[2] = { 0, 0 };
+    for (int p = 0; p < count; p++) {
+        linprog prog;
+        random_lp(n, n, orders, &prog.c, &prog.b, &prog.a);
+        prog.vars = n;
+        prog.max = 1;
+        prog.lower = 0;
+        prog.upper = 0;
+        prog.sense = 0;
+        prog.scen.count = 0;
+        vector c = vec(n), b = vec(n);
+        spmatrix a = prog.a;
+        a.value = (double*)malloc(sizeof(double) * (a.nnz > 0 ? a.nnz : 1));
+        memcpy(c.data, prog.c.data, sizeof(double) * n);
+        memcpy(b.data, prog.b.data, sizeof(double) * n);
+        memcpy(a.value, prog.a.value, sizeof(double) * a.nnz);
+
+        double objective[2];
+        for (int k = 0; k < 2; k++) {
+            double start = now();
+            scaling s;
+            if (k == 1)
+                scale_lp(&prog, &s);
+            dictionary d = revised ? revised_simplex(&prog.c, &prog.b, &prog.a, 0, 0, 0, 0, &out)
+                                   : simplex(&prog.c, &prog.b, &prog.a, 0, 0, 0, &out);
+            time[k] += now() - start;
+            d.scale = k == 1 ? &s : 0;
+            pivots[k] += d.iterations;
+            objective[k] = mat_row(&d.dic, 0)[0];
+            if (d.state == SIMPLEX_STATE_SUCCESS) {
+                solved[k]++;
+                worst[k] = fmax(worst[k], residual(&d, &b, &a));
+            }
+            if (k == 1) {
+                before += log10(s.before);
+                after += log10(s.after);
+                passes += s.passes;
+                freescaling(&s);
+            }
+            freedic(&d);
+        }
+        maxDiff = fmax(maxDiff, fabs(objective[0] - objective[1]) / (1 + fabs(objective[0])));
+
+        freevec(&prog.c);
+        freevec(&prog.b);
+        freesp(&prog.a);
+        freevec(&c);
+        freevec(&b);
+        free(a.value);
+    }
+
+    printf("%i problems of %ix%i, coefficient range 1e%.1f before and 1e%.1f after scaling, %.1f passes (mean)\n", count, n, n,
+        before / count, after / count, passes / count);
+    printf("%-10s %8s %14s %12s %16s\n", "scaling", "solved", "mean pivots", "mean ms", "worst residual");
+    for (int k = 0; k < 2; k++)
+        printf("%-10s %8i %14.1f %12.3f %16.3g\n", k == 0 ? "off" : "on", solved[k], (double)pivots[k] / count, 1000.0 * time[k] / count, worst[k]);
+    printf("max relative objective difference %g\n", maxDiff);
+    freewr(&out);
+
+}
+
+// Create a random, badly conditioned problem: a 'n' x 'n' problem of random_lp (scaled over 'orders'
+// orders of magnitude) where every fourth row is a copy of the previous one with each entry changed by
+// a relative amount of up to 'noise', and one in five bounds is zero so that most vertices are degenerate.
+void illconditioned_lp(int n, double orders, double noise, vector* c, vector* b, spmatrix* a) {
+    spmatrix base;
+    random_lp(n, n, orders, c, b, &base);
+    double* dense = (double*)calloc((size_t)n * n, sizeof(double));
+    for (int j = 0; j < n; j++)
+        for (int k = base.start[j]; k < base.start[j + 1]; k++)
+            dense[(size_t)base.index[k] * n + j] = base.value[k];
+    for (int i = 1; i < n; i++) {
+        if (i % 4 == 3) {
+            for (int j = 0; j < n; j++)
+                dense[(size_t)i * n + j] = dense[(size_t)(i - 1) * n + j] * (1.0 + noise * (rnd() - 0.5));
+            b->data[i] = b->data[i - 1];
+        } else if (rnd() < 0.2) {
+            b->data[i] = 0;
+        }
+    }
+    triplets t = trip(base.nnz * 2 + 1);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            if (dense[(size_t)i * n + j] != 0)
+                trip_add(&t, i, j, dense[(size_t)i * n + j]);
+    *a = sp_from_triplets(n, n, &t);
+    freetrip(&t);
+    freesp(&base);
+    free(dense);
+}
+
+// Solve 'count' badly conditioned problems with the textbook and the Harris ratio test, and compare the
+// verdicts, iterations, time and the accuracy of the solutions.
+void bench_harris(int n, int count, double orders, double noise, int revised) {
+
+    writer out = wr(0, VERBOSITY_QUIET);
+    long pivots[2] = { 0, 0 };
+    double time[2] = { 0, 0 }, worst[2] = { 0, 0 }, maxDiff = 0;
+    int solved[2] = { 0, 0 }, unbounded[2] = { 0, 0 }, other[2] = { 0, 0 };
+    for (int p = 0; p < count; p++) {
+        vector c, b;
+        spmatrix a;
+        illconditioned_lp(n, orders, noise, &c, &b, &a);
+        double objective[2];
+        for (int k = 0; k < 2; k++) {
+            tolerance_opts.harris = k;
+            double start = now();
+            dictionary d = revised ? revised_simplex(&c, &b, &a, 0, 0, 0, 0, &out) : simplex(&c, &b, &a, 0, 0, 0, &out);
+            time[k] += now() - start;
+            pivots[k] += d.iterations;
+            objective[k] = mat_row(&d.dic, 0)[0];
+            if (d.state == SIMPLEX_STATE_SUCCESS) {
+                solved[k]++;
+                worst[k] = fmax(worst[k], residual(&d, &b, &a));
+            } else if (d.state == SIMPLEX_STATE_UNBOUNDED) {
+                unbounded[k]++; // Every problem is bounded by its first row
+            } else {
+                other[k]++;
+            }
+            freedic(&d);
+        }
+        maxDiff = fmax(maxDiff, fabs(objective[0] - objective[1]) / (1 + fabs(objective[0])));
+        freevec(&c);
+        freevec(&b);
+        freesp(&a);
+    }
+    tolerance_opts.harris = 0;
+
+    printf("%i problems of %ix%i, %.1f orders of magnitude, near-duplicate rows within %g\n", count, n, n, orders, noise);
+    printf("%-10s %8s %10s %8s %14s %12s %16s\n", "ratio", "solved", "unbounded", "other", "mean pivots", "mean ms", "worst residual");
+    for (int k = 0; k < 2; k++)
+        printf("%-10s %8i %10i %8i %14.1f %12.3f %16.3g\n", k == 0 ? "textbook" : "harris", solved[k], unbounded[k], other[k],
+            (double)pivots[k] / count, 1000.0 * time[k] / count, worst[k]);
+    printf("max relative objective difference %g\n", maxDiff);
+    freewr(&out);
+
+}
+
+// Solve the same 'count' random 'n' x 'n' problems (a third of the rows >= constraints, so most need
+// phase one) with the heap and with one reused solver context, and compare the time per problem.
+void bench_context(int n, int count, int revised) {
+
+    vector* c = (vector*)malloc(sizeof(vector) * count);
+    vector* b = (vector*)malloc(sizeof(vector) * count);
+    spmatrix* a = (spmatrix*)malloc(sizeof(spmatrix) * count);
+    for (int p = 0; p < count; p++) {
+        random_lp(n, n, 0, &c[p], &b[p], &a[p]);
+        for (int j = 0; j < n; j++)
+            for (int e = a[p].start[j]; e < a[p].start[j + 1]; e++)
+                if (a[p].index[e] % 3 == 2)
+                    a[p].value[e] = -a[p].value[e];
+        for (int i = 2; i < n; i += 3)
+            b[p].data[i] = -0.5 * b[p].data[i];
+    }
+
+    writer out = wr(0, VERBOSITY_QUIET);
+    simplex_context ctx = context(0);
+    double time[2] = { 0, 0 }, sum[2] = { 0, 0 };
+    long pivots = 0;
+    for (int k = 0; k < 2; k++) {
+        simplex_context* use = k == 1 ? &ctx : 0;
+        double start = now();
+        for (int p = 0; p < count; p++) {
+            if (use)
+                context_reset(use, context_size(n, n, revised));
+            dictionary d = revised ? revised_simplex(&c[p], &b[p], &a[p], 0, 0, 0, use, &out)
+                                   : simplex(&c[p], &b[p], &a[p], 0, 0, use, &out);
+            sum[k] += d.state == SIMPLEX_STATE_SUCCESS ? mat_row(&d.dic, 0)[0] : 0;
+            pivots += k == 0 ? d.iterations : 0;
+            freedic(&d);
+        }
+        time[k] = now() - start;
+    }
+
+    printf("%i problems of %ix%i (%s engine), %.1f pivots per problem\n", count, n, n, revised ? "revised" : "tableau", (double)pivots / count);
+    printf("%-10s %12s %14s\n", "memory", "mean ms", "ms per pivot");
+    for (int k = 0; k < 2; k++)
+        printf("%-10s %12.4f %14.5f\n", k == 0 ? "heap" : "context", 1000.0 * time[k] / count, 1000.0 * time[k] / (pivots > 0 ? pivots : 1));
+    printf("arena of %zu bytes, %li requests went to the heap, objective sums %s\n", ctx.size, ctx.overflows,
+        sum[0] == sum[1] ? "match" : "differ");
+
+    freecontext(&ctx);
+    freewr(&out);
+    for (int p = 0; p < count; p++) {
+        freevec(&c[p]);
+        freevec(&b[p]);
+        freesp(&a[p]);
+    }
+    free(c);
+    free(b);
+    free(a);
+
+}
+
+// Create a random wide problem with 'm' constraints on 'n' variables and 'per' nonzeros in every column.
+void random_wide(int m, int n, int per, vector* c, vector* b, spmatrix* a) {
+    *c = vec(n);
+    *b = vec(m);
+    triplets t = trip(n * per);
+    for (int j = 0; j < n; j++) {
+        c->data[j] = 1.0 + 9.0 * rnd();
+        for (int k = 0; k < per; k++)
+            trip_add(&t, (int)(rnd() * m), j, 0.1 + rnd());
+    }
+    for (int i = 0; i < m; i++)
+        b->data[i] = 1.0 + 99.0 * rnd();
+    *a = sp_from_triplets(m, n, &t);
+    freetrip(&t);
+}
+
+// Solve a wide problem with the revised engine under full, partial and multiple pricing.
+void bench_wide(int m, int n, int window, int candidates) {
+
+    int windows[] = { 0, window, 0, window };
+    int lists[] = { 0, 0, candidates, candidates };
+    vector c, b;
+    spmatrix a;
+    random_wide(m, n, 5, &c, &b, &a);
+    writer out = wr(0, VERBOSITY_QUIET);
+    printf("%ix%i, %i nonzeros\n", m, n, a.nnz);
+    printf("%8s %10s %12s %10s %14s %14s\n", "window", "candidates", "iterations", "time (s)", "ms/iteration", "objective");
+    for (int k = 0; k < 4; k++) {
+        pricing_opts.window = windows[k];
+        pricing_opts.candidates = lists[k];
+        double start = now();
+        dictionary d = revised_simplex(&c, &b, &a, 0, 0, 0, 0, &out);
+        double total = now() - start;
+        printf("%8i %10i %12i %10.3f %14.4f %14.6f\n", windows[k], lists[k], d.iterations, total,
+            d.iterations ? 1000.0 * total / d.iterations : 0.0, mat_row(&d.dic, 0)[0]);
+        freedic(&d);
+    }
+    pricing_opts.window = 0;
+    pricing_opts.candidates = 0;
+    freewr(&out);
+    freevec(&c);
+    freevec(&b);
+    freesp(&a);
+
+}
+
+// Solve 'count' scenarios of a random 'n' x 'n' problem that scale every bound ("rhs"), every objective
+// coefficient ("objective") or either of them ("mixed") by up to 5%, once as independent solves from
+// scratch and once through solve_scenarios on one and on 'threads' chains.
+void bench_scenarios(int n, int count, const char* kind, int threads) {
+
+    linprog p;
+    random_lp(n, n, 0, &p.c, &p.b, &p.a);
+    p.vars = n;
+    p.max = 1;
+    p.sense = 0;
+    p.lower = 0;
+    p.upper = 0;
+    p.file.data = 0;
+    scenario_set* s = &p.scen;
+    s->count = count;
+    s->objective = (char*)malloc(count);
+    s->start = (int*)malloc(sizeof(int) * (count + 1));
+    s->index = (int*)malloc(sizeof(int) * count * n);
+    s->value = (double*)malloc(sizeof(double) * count * n);
+    for (int k = 0; k < count; k++) {
+        s->objective[k] = strcmp(kind, "objective") == 0 || (strcmp(kind, "mixed") == 0 && rnd() < 0.5);
+        s->start[k] = k * n;
+        vector* base = s->objective[k] ? &p.c : &p.b;
+        for (int i = 0; i < n; i++) {
+            s->index[k * n + i] = i;
+            s->value[k * n + i] = base->data[i] * (0.95 + 0.1 * rnd());
+        }
+    }
+    s->start[count] = count * n;
+
+    // Independent solves
+    writer out = wr(0, VERBOSITY_QUIET);
+    simplex_context ctx = context(0);
+    vector c = vec(n), b = vec(n);
+    vec_copy(&p.c, &c);
+    vec_copy(&p.b, &b);
+    long pivots = 0;
+    double start = now();
+    for (int k = 0; k < count; k++) {
+        if (k > 0)
+            scenario_apply(&p, k - 1, &c, &b, 1);
+        scenario_apply(&p, k, &c, &b, 0);
+        context_reset(&ctx, context_size(n, n, 0));
+        dictionary d = simplex(&c, &b, &p.a, 0, 0, &ctx, &out);
+        pivots += d.iterations;
+        freedic(&d);
+    }
+    double independent = now() - start;
+
+    // Chains, starting from the optimal basis of the problem itself
+    dictionary optimal = simplex(&p.c, &p.b, &p.a, 0, 0, 0, &out);
+    double chained[2];
+    int used[2] = { 1, threads };
+    for (int k = 0; k < 2; k++) {
+        pool_start(used[k]);
+        out.size = 0;
+        start = now();
+        solve_scenarios("bench", &p, &optimal, 0, 0, &out);
+        chained[k] = now() - start;
+        used[k] = pool.threads;
+        pool_stop();
+    }
+
+    printf("%i %s scenarios of %ix%i, %.1f pivots per independent solve\n", count, kind, n, n, (double)pivots / count);
+    printf("%-22s %10s %14s\n", "method", "time (ms)", "ms/scenario");
+    printf("%-22s %10.2f %14.4f\n", "independent", 1000.0 * independent, 1000.0 * independent / count);
+    for (int k = 0; k < 2; k++) {
+        char name[32];
+        snprintf(name, sizeof(name), "chained (%i chain%s)", used[k], used[k] > 1 ? "s" : "");
+        printf("%-22s %10.2f %14.4f\n", name, 1000.0 * chained[k], 1000.0 * chained[k] / count);
+    }
+
+    freedic(&optimal);
+    freecontext(&ctx);
+    freewr(&out);
+    freevec(&c);
+    freevec(&b);
+    freelp(&p);
+
+}
+
+// Parameters of a generated problem (see generate_lp)
+typedef struct {
+    char name[32]; // The instance name in reports
+    int vars, rows; // The amount of variables and constraints
+    double density; // The share of nonzero constraint coefficients
+    double degeneracy; // The share of constraints that are tight at the planted solution
+    double ge, eq; // The share of '>=' and '=' constraints (the rest are '<=')
+    int outcome; // The expected final state: SIMPLEX_STATE_SUCCESS, _INFEASIBLE or _UNBOUNDED
+    unsigned long long seed; // The seed of the generator
+} lp_spec;
+
+// Set a field of 'spec' from a 'key=value' pair, returns 0 if the key or value is not valid.
+int spec_set(lp_spec* spec, const char* key, const char* value) {
+    if (strcmp(key, "name") == 0)
+        snprintf(spec->name, sizeof(spec->name), "%s", value);
+    else if (strcmp(key, "vars") == 0)
+        spec->vars = atoi(value);
+    else if (strcmp(key, "rows") == 0)
+        spec->rows = atoi(value);
+    else if (strcmp(key, "density") == 0)
+        spec->density = atof(value);
+    else if (strcmp(key, "degeneracy") == 0)
+        spec->degeneracy = atof(value);
+    else if (strcmp(key, "ge") == 0)
+        spec->ge = atof(value);
+    else if (strcmp(key, "eq") == 0)
+        spec->eq = atof(value);
+    else if (strcmp(key, "seed") == 0)
+        spec->seed = strtoull(value, 0, 10);
+    else if (strcmp(key, "outcome") == 0) {
+        if (strcmp(value, "feasible") == 0)
+            spec->outcome = SIMPLEX_STATE_SUCCESS;
+        else if (strcmp(value, "infeasible") == 0)
+            spec->outcome = SIMPLEX_STATE_INFEASIBLE;
+        else if (strcmp(value, "unbounded") == 0)
+            spec->outcome = SIMPLEX_STATE_UNBOUNDED;
+        else
+            return 0;
+    } else
+        return 0;
+    return 1;
+}
+
+// Parse a comma separated list of 'key=value' pairs (for example "vars=100,rows=80,eq=0.2") into 'spec',
+// keys that are not given keep their value. Returns 0 if the text is not valid.
+int parse_spec(const char* text, lp_spec* spec) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", text);
+    for (char* pair = strtok(buf, ","); pair; pair = strtok(0, ",")) {
+        char* eq = strchr(pair, '=');
+        if (!eq)
+            return 0;
+        *eq = 0;
+        if (!spec_set(spec, pair, eq + 1))
+            return 0;
+    }
+    return spec->vars > 0 && spec->rows >= 0 && spec->density > 0 && spec->density <= 1 && spec->ge + spec->eq <= 1;
+}
+
+// Get the name of an outcome.
+const char* outcome_name(int state) {
+    switch (state) {
+    case SIMPLEX_STATE_SUCCESS: return "feasible";
+    case SIMPLEX_STATE_INFEASIBLE: return "infeasible";
+    case SIMPLEX_STATE_UNBOUNDED: return "unbounded";
+    case SIMPLEX_STATE_ITERATION_LIMIT: return "limit";
+    default: return "unknown";
+    }
+}
+
+// Generate the problem described by 'spec' (in the form read_model returns it), the same seed always gives
+// the same problem. Every problem maximizes over a planted solution x >= 0 (a fifth of it zero), so the
+// rows that are tight at x make the problem degenerate. A feasible problem gets an extra row bounding the
+// sum of all variables; an infeasible one also gets a pair of rows that bound the sum of a random subset of
+// the variables from both sides with a gap; an unbounded one has no bounding row, and one column with a
+// positive cost only has entries that keep the constraints satisfied as it grows.
+linprog generate_lp(lp_spec* spec) {
+
+    unsigned long long saved = rng_state;
+    rng_state = spec->seed ? spec->seed : 88172645463325252ULL;
+    int n = spec->vars, rows = spec->rows;
+    int m = rows + (spec->outcome == SIMPLEX_STATE_SUCCESS ? 1 : spec->outcome == SIMPLEX_STATE_INFEASIBLE ? 3 : 0);
+
+    linprog p;
+    p.vars = n;
+    p.max = 1;
+    p.c = vec(n);
+    p.b = vec(m);
+    p.sense = (signed char*)malloc(m > 0 ? m : 1);
+    p.lower = 0;
+    p.upper = 0;
+    p.file.data = 0;
+    p.scen.count = 0;
+
+    // The planted solution and the costs
+    double* x = (double*)malloc(sizeof(double) * n);
+    double total = 0;
+    for (int j = 0; j < n; j++) {
+        x[j] = rnd() < 0.2 ? 0 : 1.0 + 4.0 * rnd();
+        total += x[j];
+        p.c.data[j] = rnd() < 0.2 ? -1.0 - 9.0 * rnd() : 1.0 + 9.0 * rnd();
+    }
+    int ray = spec->outcome == SIMPLEX_STATE_UNBOUNDED ? (int)(rnd() * n) : -1;
+    if (ray >= 0)
+        p.c.data[ray] = 1.0 + 9.0 * rnd();
+
+    // Random rows, with at least one entry each
+    triplets t = trip((int)(spec->density * n * rows) + rows + 3 * n + 16);
+    double* row = (double*)malloc(sizeof(double) * n);
+    for (int i = 0; i < rows; i++) {
+        double kind = rnd();
+        p.sense[i] = kind < spec->eq ? SENSE_EQ : kind < spec->eq + spec->ge ? SENSE_GE : SENSE_LE;
+        for (int j = 0; j < n; j++)
+            row[j] = rnd() < spec->density ? (rnd() < 0.3 ? -1.0 : 1.0) * (0.1 + 9.9 * rnd()) : 0;
+        if (ray >= 0) // Growing the ray column keeps every row satisfied
+            row[ray] = p.sense[i] == SENSE_EQ ? 0 : p.sense[i] == SENSE_LE ? -fabs(row[ray]) : fabs(row[ray]);
+        int first = (ray + 1 + (int)(rnd() * (n - 1))) % n; // Not the ray column, unless it is the only one
+        if (row[first] == 0)
+            row[first] = 1.0 + rnd();
+        double ax = 0;
+        for (int j = 0; j < n; j++) {
+            if (row[j] != 0) {
+                trip_add(&t, i, j, row[j]);
+                ax += row[j] * x[j];
+            }
+        }
+        double slack = rnd() < spec->degeneracy ? 0 : 1.0 + 10.0 * rnd();
+        p.b.data[i] = p.sense[i] == SENSE_EQ ? ax : p.sense[i] == SENSE_LE ? ax + slack : ax - slack;
+    }
+
+    // Bound the problem, and make it infeasible by bounding a subset from both sides
+    if (ray < 0) {
+        for (int j = 0; j < n; j++)
+            trip_add(&t, rows, j, 1.0);
+        p.b.data[rows] = total + 1.0 + 10.0 * rnd();
+        p.sense[rows] = SENSE_LE;
+    }
+    if (spec->outcome == SIMPLEX_STATE_INFEASIBLE) {
+        double sum = 0;
+        for (int j = 0; j < n; j++) {
+            if (rnd() < 0.5 || j == n - 1) {
+                trip_add(&t, rows + 1, j, 1.0);
+                trip_add(&t, rows + 2, j, 1.0);
+                sum += x[j];
+            }
+        }
+        p.b.data[rows + 1] = sum + 1.0 + rnd();
+        p.sense[rows + 1] = SENSE_GE;
+        p.b.data[rows + 2] = sum;
+        p.sense[rows + 2] = SENSE_LE;
+    }
+
+    p.a = sp_from_triplets(m, n, &t);
+    freetrip(&t);
+    free(row);
+    free(x);
+    rng_state = saved;
+    return p;
+
+}
+
+// Write 'prog' (in the form read_model returns it) to a text problem file with sparse rows.
+int write_text(linprog* prog, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f)
+        return 0;
+    int m = prog->b.size;
+    fprintf(f, "variables %i\n%s", prog->vars, prog->max ? "max" : "min");
+    for (int j = 0; j < prog->vars; j++)
+        if (prog->c.data[j] != 0)
+            fprintf(f, " %i:%.17g", j + 1, prog->c.data[j]);
+    fprintf(f, "\nconstraints %i\n", m);
+
+    // Rows from the columns of A
+    int* count = (int*)calloc(m + 1, sizeof(int));
+    for (int k = 0; k < prog->a.nnz; k++)
+        count[prog->a.index[k] + 1]++;
+    for (int i = 0; i < m; i++)
+        count[i + 1] += count[i];
+    int* column = (int*)malloc(sizeof(int) * (prog->a.nnz + 1));
+    double* value = (double*)malloc(sizeof(double) * (prog->a.nnz + 1));
+    int* fill = (int*)malloc(sizeof(int) * (m + 1));
+    memcpy(fill, count, sizeof(int) * (m + 1));
+    for (int j = 0; j < prog->vars; j++) {
+        for (int k = prog->a.start[j]; k < prog->a.start[j + 1]; k++) {
+            int at = fill[prog->a.index[k]]++;
+            column[at] = j;
+            value[at] = prog->a.value[k];
+        }
+    }
+    for (int i = 0; i < m; i++) {
+        if (count[i] == count[i + 1]) // An empty row still needs a coefficient
+            fprintf(f, "1:0");
+        for (int k = count[i]; k < count[i + 1]; k++)
+            fprintf(f, "%s%i:%.17g", k > count[i] ? " " : "", column[k] + 1, value[k]);
+        fprintf(f, " %s %.17g\n", prog->sense[i] == SENSE_LE ? "<=" : prog->sense[i] == SENSE_GE ? ">=" : "=", prog->b.data[i]);
+    }
+
+    free(count);
+    free(column);
+    free(value);
+    free(fill);
+    return fclose(f) == 0;
+}
+
+// Solve 'p' (in the form the solvers take, without bounds) with 'engine' (ENGINE_*).
+dictionary solve_with(int engine, linprog* p, simplex_context* ctx, writer* out) {
+    if (engine == ENGINE_IPM)
+        return interior_point(&p->c, &p->b, &p->a, p->sense, 0, ctx, out);
+    if (engine == ENGINE_REVISED)
+        return revised_simplex(&p->c, &p->b, &p->a, p->sense, 0, 0, ctx, out);
+    return simplex(&p->c, &p->b, &p->a, p->sense, 0, ctx, out);
+}
+
+// A small problem with a known outcome: maximize c x subject to the rows of 'a'.
+typedef struct {
+    const char* name;
+    int vars, rows;
+    double c[4];
+    double a[4][4];
+    signed char sense[4];
+    double b[4];
+    int state;
+    double value;
+} check_case;
+
+// Problems that once went wrong in one of the engines.
+check_case check_cases[] = {
+    // The slack of the equality row stays basic at zero after phase one and must not grow in phase two
+    { "eq-basic-slack", 2, 3, { 1, 0 }, { { -1, 1 }, { 1, 0 }, { 0, 1 } },
+      { SENSE_EQ, SENSE_LE, SENSE_LE }, { 0, 5, 2 }, SIMPLEX_STATE_SUCCESS, 2.0 },
+    { "eq-bounded", 2, 2, { 1, 0 }, { { -1, 1 }, { 0, 1 } },
+      { SENSE_EQ, SENSE_LE }, { 0, 5 }, SIMPLEX_STATE_SUCCESS, 5.0 },
+    // Repeated equality rows, the slack of one of them ends basic in the interior point engine
+    { "eq-repeated", 3, 4, { 1, 0, 1 }, { { -3, 0, -3 }, { -9, 0, -9 }, { 2, 2, 3 }, { 2, 3, 0 } },
+      { SENSE_EQ, SENSE_EQ, SENSE_LE, SENSE_LE }, { 0, 0, 2, 5 }, SIMPLEX_STATE_SUCCESS, 0.0 },
+    { "eq-repeated-bounded", 4, 3, { -2, 2, 1, -2 }, { { 3, -3, 2, 3 }, { 9, -9, 6, 9 }, { 3, 0, 1, 0 } },
+      { SENSE_EQ, SENSE_EQ, SENSE_LE }, { 0, 0, 6 }, SIMPLEX_STATE_SUCCESS, 14.0 },
+};
+
+// Solve every check case with every engine and compare with the known outcome.
+// Returns the number of mismatches.
+int check_problems(void) {
+    writer out = wr(0, VERBOSITY_QUIET);
+    simplex_context ctx = context(0);
+    int failures = 0;
+    for (size_t k = 0; k < sizeof(check_cases) / sizeof(check_cases[0]); k++) {
+        check_case* cc = &check_cases[k];
+        linprog p;
+        p.vars = cc->vars;
+        p.max = 1;
+        p.c = vec(cc->vars);
+        p.b = vec(cc->rows);
+        p.sense = (signed char*)malloc(cc->rows);
+        p.lower = 0;
+        p.upper = 0;
+        p.file.data = 0;
+        p.scen.count = 0;
+        triplets t = trip(cc->rows * cc->vars);
+        for (int j = 0; j < cc->vars; j++)
+            p.c.data[j] = cc->c[j];
+        for (int i = 0; i < cc->rows; i++) {
+            p.b.data[i] = cc->b[i];
+            p.sense[i] = cc->sense[i];
+            for (int j = 0; j < cc->vars; j++)
+                if (cc->a[i][j] != 0)
+                    trip_add(&t, i, j, cc->a[i][j]);
+        }
+        p.a = sp_from_triplets(cc->rows, cc->vars, &t);
+        freetrip(&t);
+        lp_normalize(&p);
+        for (int e = ENGINE_TABLEAU; e <= ENGINE_IPM; e++) {
+            context_reset(&ctx, context_size(p.b.size, p.vars, e));
+            dictionary d = solve_with(e, &p, &ctx, &out);
+            int ok = d.state == cc->state;
+            if (ok && d.state == SIMPLEX_STATE_SUCCESS)
+                ok = fabs(mat_row(&d.dic, 0)[0] - cc->value) <= 1e-6 * (1 + fabs(cc->value));
+            if (!ok) {
+                printf("%s with %s: state %i objective %g, expected state %i objective %g\n", cc->name, engine_names[e],
+                    d.state, d.state == SIMPLEX_STATE_SUCCESS ? mat_row(&d.dic, 0)[0] : 0.0, cc->state, cc->value);
+                failures++;
+            }
+            freedic(&d);
+        }
+        freelp(&p);
+    }
+    freecontext(&ctx);
+    freewr(&out);
+    return failures;
+}
+
+// Solve generated feasible problems of 100 x 100 up to 'largest' x 'largest' (doubling the size) with
+// 'density', once with every engine, and compare the times. The pivots of the interior point engine are
+// those of its crossover.
+void bench_ipm(int largest, double density) {
+    writer out = wr(0, VERBOSITY_QUIET);
+    simplex_context ctx = context(0);
+    printf("%6s %8s", "size", "nonzeros");
+    for (int e = ENGINE_TABLEAU; e <= ENGINE_IPM; e++)
+        printf(" %11s ms %7s", engine_names[e], "pivots");
+    printf(" %9s %s\n", "speedup", "objective");
+    for (int n = 100; n <= largest; n *= 2) {
+        lp_spec spec = { "ipm", n, n, density, 0.1, 0.2, 0.1, SIMPLEX_STATE_SUCCESS, (unsigned long long)n };
+        linprog p = generate_lp(&spec);
+        lp_normalize(&p);
+        double time[3], value[3];
+        int agree = 1;
+        printf("%6i %8i", n, p.a.nnz);
+        for (int e = ENGINE_TABLEAU; e <= ENGINE_IPM; e++) {
+            double start = now();
+            context_reset(&ctx, context_size(p.b.size, p.vars, e));
+            dictionary d = solve_with(e, &p, &ctx, &out);
+            time[e] = now() - start;
+            value[e] = d.state == SIMPLEX_STATE_SUCCESS ? mat_row(&d.dic, 0)[0] : NAN;
+            agree &= fabs(value[e] - value[ENGINE_TABLEAU]) <= 1e-6 * (1 + fabs(value[ENGINE_TABLEAU]));
+            printf(" %14.2f %7i", 1000.0 * time[e], d.iterations);
+            freedic(&d);
+        }
+        double simplex = time[ENGINE_TABLEAU] < time[ENGINE_REVISED] ? time[ENGINE_TABLEAU] : time[ENGINE_REVISED];
+        printf(" %8.2fx %s\n", simplex / time[ENGINE_IPM], agree ? "same" : "DIFFERENT");
+        freelp(&p);
+    }
+    freecontext(&ctx);
+    freewr(&out);
+}
+
+// The default instances of the suite: every size, density, degeneracy and row mix is covered by at least
+// one instance, and every outcome by at least two.
+lp_spec suite_instances[] = {
+    { "small-le", 40, 30, 0.5, 0.0, 0.0, 0.0, SIMPLEX_STATE_SUCCESS, 1 },
+    { "small-mixed", 40, 30, 0.5, 0.2, 0.3, 0.2, SIMPLEX_STATE_SUCCESS, 2 },
+    { "degenerate", 80, 60, 0.4, 0.7, 0.2, 0.1, SIMPLEX_STATE_SUCCESS, 3 },
+    { "equalities", 100, 60, 0.3, 0.1, 0.1, 0.5, SIMPLEX_STATE_SUCCESS, 4 },
+    { "sparse", 300, 200, 0.03, 0.2, 0.2, 0.1, SIMPLEX_STATE_SUCCESS, 5 },
+    { "dense", 150, 120, 0.9, 0.1, 0.2, 0.1, SIMPLEX_STATE_SUCCESS, 6 },
+    { "wide", 600, 60, 0.2, 0.1, 0.2, 0.1, SIMPLEX_STATE_SUCCESS, 7 },
+    { "tall", 60, 300, 0.2, 0.1, 0.3, 0.0, SIMPLEX_STATE_SUCCESS, 8 },
+    { "large", 400, 300, 0.1, 0.3, 0.2, 0.1, SIMPLEX_STATE_SUCCESS, 9 },
+    { "infeasible", 80, 60, 0.3, 0.2, 0.2, 0.1, SIMPLEX_STATE_INFEASIBLE, 10 },
+    { "infeasible-large", 300, 200, 0.1, 0.2, 0.2, 0.1, SIMPLEX_STATE_INFEASIBLE, 11 },
+    { "unbounded", 80, 60, 0.3, 0.2, 0.2, 0.1, SIMPLEX_STATE_UNBOUNDED, 12 },
+    { "unbounded-large", 300, 200, 0.1, 0.2, 0.2, 0.1, SIMPLEX_STATE_UNBOUNDED, 13 },
+};
+
+// Suite settings
+typedef struct {
+    int engine; // The engine to solve with (ENGINE_*)
+    int repeats; // The amount of timed solves of every instance
+    const char* format; // The report format: "table", "csv" or "json"
+    const char* output; // The file the report is written to (0 for stdout)
+    const char* baseline; // The CSV report to compare against (0 to not compare)
+    double threshold; // The relative increase of the median time that counts as a regression
+} suite_options;
+
+// The result of one instance of the suite
+typedef struct {
+    lp_spec* spec;
+    int nnz; // The nonzeros of the constraint matrix
+    int state; // The final state
+    int iterations; // The pivots of a solve
+    double median, p95; // The wall time of a solve in seconds
+} suite_result;
+
+// Compare doubles for qsort.
+int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Generate and solve the instance 'spec' 'opts->repeats' times (after one untimed solve), solving from
+// 'ctx' like solve_file does.
+suite_result run_instance(lp_spec* spec, suite_options* opts, simplex_context* ctx, writer* out) {
+
+    linprog p = generate_lp(spec);
+    lp_normalize(&p);
+    suite_result r;
+    r.spec = spec;
+    r.nnz = p.a.nnz;
+    double* time = (double*)malloc(sizeof(double) * opts->repeats);
+    for (int k = -1; k < opts->repeats; k++) {
+        double start = now();
+        context_reset(ctx, context_size(p.b.size, p.vars, opts->engine));
+        dictionary d = solve_with(opts->engine, &p, ctx, out);
+        double elapsed = now() - start;
+        if (k >= 0)
+            time[k] = elapsed;
+        r.state = d.state;
+        r.iterations = d.iterations;
+        freedic(&d);
+    }
+
+    // Nearest rank percentiles
+    qsort(time, opts->repeats, sizeof(double), cmp_double);
+    int n = opts->repeats;
+    r.median = n % 2 ? time[n / 2] : 0.5 * (time[n / 2 - 1] + time[n / 2]);
+    r.p95 = time[(int)ceil(0.95 * n) - 1];
+    free(time);
+    freelp(&p);
+    return r;
+
+}
+
+// Write the results of the suite in the format of 'opts'.
+void write_report(FILE* f, suite_result* results, int count, suite_options* opts) {
+    int csv = strcmp(opts->format, "csv") == 0, json = strcmp(opts->format, "json") == 0;
+    if (csv)
+        fprintf(f, "instance,vars,rows,nonzeros,expected,status,iterations,median_ms,p95_ms,pivots_per_s\n");
+    else if (json)
+        fprintf(f, "{\n  \"engine\": \"%s\",\n  \"repeats\": %i,\n  \"instances\": [\n", engine_names[opts->engine], opts->repeats);
+    else
+        fprintf(f, "%-18s %6s %6s %8s %11s %11s %10s %11s %11s %12s\n", "instance", "vars", "rows", "nonzeros", "expected",
+            "status", "iterations", "median ms", "p95 ms", "pivots/s");
+    for (int k = 0; k < count; k++) {
+        suite_result* r = &results[k];
+        double rate = r->median > 0 ? r->iterations / r->median : 0;
+        const char* expected = outcome_name(r->spec->outcome);
+        const char* status = outcome_name(r->state);
+        if (csv)
+            fprintf(f, "%s,%i,%i,%i,%s,%s,%i,%.4f,%.4f,%.0f\n", r->spec->name, r->spec->vars, r->spec->rows, r->nnz, expected, status,
+                r->iterations, 1000.0 * r->median, 1000.0 * r->p95, rate);
+        else if (json)
+            fprintf(f, "    { \"instance\": \"%s\", \"vars\": %i, \"rows\": %i, \"nonzeros\": %i, \"expected\": \"%s\", \"status\": \"%s\", "
+                "\"iterations\": %i, \"median_ms\": %.4f, \"p95_ms\": %.4f, \"pivots_per_s\": %.0f }%s\n", r->spec->name, r->spec->vars,
+                r->spec->rows, r->nnz, expected, status, r->iterations, 1000.0 * r->median, 1000.0 * r->p95, rate, k + 1 < count ? "," : "");
+        else
+            fprintf(f, "%-18s %6i %6i %8i %11s %11s %10i %11.4f %11.4f %12.0f\n", r->spec->name, r->spec->vars, r->spec->rows, r->nnz,
+                expected, status, r->iterations, 1000.0 * r->median, 1000.0 * r->p95, rate);
+    }
+    if (json)
+        fprintf(f, "  ]\n}\n");
+}
+
+// Compare the results with a CSV report of an earlier run (written with --format csv) and print every
+// instance that is slower by more than the threshold, needs more pivots or ends in another state.
+// Returns the amount of regressions.
+int compare_baseline(suite_result* results, int count, suite_options* opts) {
+
+    FILE* f = fopen(opts->baseline, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to read baseline: %s\n", opts->baseline);
+        return -1;
+    }
+
+    char line[512];
+    int regressions = 0, matched = 0;
+    printf("\n%-18s %12s %12s %9s %16s  %s\n", "instance", "baseline ms", "median ms", "change", "iterations", "verdict");
+    while (fgets(line, sizeof(line), f)) {
+
+        // instance,vars,rows,nonzeros,expected,status,iterations,median_ms,...
+        char* field[10];
+        int fields = 0;
+        for (char* s = strtok(line, ",\r\n"); s && fields < 10; s = strtok(0, ",\r\n"))
+            field[fields++] = s;
+        if (fields < 8 || strcmp(field[0], "instance") == 0)
+            continue;
+        suite_result* r = 0;
+        for (int k = 0; k < count; k++)
+            if (strcmp(results[k].spec->name, field[0]) == 0)
+                r = &results[k];
+        if (!r)
+            continue;
+        matched++;
+
+        double base = atof(field[7]), median = 1000.0 * r->median;
+        int baseIterations = atoi(field[6]);
+        double change = base > 0 ? median / base - 1.0 : 0;
+        const char* verdict = "ok";
+        if (strcmp(field[5], outcome_name(r->state)) != 0)
+            verdict = "REGRESSION (status)";
+        else if (r->iterations > baseIterations)
+            verdict = "REGRESSION (iterations)";
+        else if (change > opts->threshold)
+            verdict = "REGRESSION (time)";
+        else if (change < -opts->threshold || r->iterations < baseIterations)
+            verdict = "improved";
+        regressions += strncmp(verdict, "REGRESSION", 10) == 0;
+        printf("%-18s %12.4f %12.4f %+8.1f%% %7i -> %6i  %s\n", r->spec->name, base, median, 100.0 * change, baseIterations,
+            r->iterations, verdict);
+
+    }
+    fclose(f);
+    printf("%i of %i instances compared, %i regressions (threshold %.0f%%)\n", matched, count, regressions, 100.0 * opts->threshold);
+    return regressions;
+
+}
+
+// Run the suite (or the instances given with --instance) and report it, returns the exit code: 1 if an
+// instance ends in another state than expected or the baseline comparison finds a regression.
+int bench_suite(int argc, char** args) {
+
+    suite_options opts = { ENGINE_TABLEAU, 5, "table", 0, 0, 0.1 };
+    lp_spec custom[64];
+    int customCount = 0;
+    for (int k = 0; k < argc; k++) {
+        int more = k + 1 < argc;
+        if (strcmp(args[k], "--engine") == 0 && more) {
+            k++;
+            opts.engine = -1;
+            for (int e = ENGINE_TABLEAU; e <= ENGINE_IPM; e++)
+                if (strcmp(args[k], engine_names[e]) == 0)
+                    opts.engine = e;
+            if (opts.engine == -1) {
+                fprintf(stderr, "Unknown engine '%s' (allowed: tableau, revised, ipm)\n", args[k]);
+                return 1;
+            }
+        } else if (strcmp(args[k], "--repeats") == 0 && more) {
+            opts.repeats = atoi(args[++k]);
+        } else if (strcmp(args[k], "--format") == 0 && more) {
+            opts.format = args[++k];
+        } else if (strcmp(args[k], "--output") == 0 && more) {
+            opts.output = args[++k];
+        } else if (strcmp(args[k], "--baseline") == 0 && more) {
+            opts.baseline = args[++k];
+        } else if (strcmp(args[k], "--threshold") == 0 && more) {
+            opts.threshold = atof(args[++k]);
+        } else if (strcmp(args[k], "--instance") == 0 && more && customCount < 64) {
+            lp_spec* s = &custom[customCount];
+            *s = suite_instances[1];
+            snprintf(s->name, sizeof(s->name), "custom-%i", customCount + 1);
+            if (!parse_spec(args[++k], s)) {
+                fprintf(stderr, "Invalid instance: %s\n", args[k]);
+                return 1;
+            }
+            customCount++;
+        } else {
+            fprintf(stderr, "Unknown suite option '%s'\n", args[k]);
+            return 1;
+        }
+    }
+    if (opts.repeats < 1)
+        opts.repeats = 1;
+
+    lp_spec* specs = customCount ? custom : suite_instances;
+    int count = customCount ? customCount : (int)(sizeof(suite_instances) / sizeof(lp_spec));
+    suite_result* results = (suite_result*)malloc(sizeof(suite_result) * count);
+    writer out = wr(0, VERBOSITY_QUIET);
+    simplex_context ctx = context(0);
+    int wrong = 0;
+    for (int k = 0; k < count; k++) {
+        results[k] = run_instance(&specs[k], &opts, &ctx, &out);
+        wrong += results[k].state != specs[k].outcome;
+    }
+    freecontext(&ctx);
+    freewr(&out);
+
+    FILE* f = opts.output ? fopen(opts.output, "w") : stdout;
+    if (!f) {
+        fprintf(stderr, "Failed to write '%s'.\n", opts.output);
+        free(results);
+        return 1;
+    }
+    write_report(f, results, count, &opts);
+    if (opts.output)
+        fclose(f);
+    if (wrong)
+        fprintf(stderr, "%i instances did not end in the expected state\n", wrong);
+    int regressions = opts.baseline ? compare_baseline(results, count, &opts) : 0;
+    free(results);
+    return wrong || regressions ? 1 : 0;
+
+}
+
+int main(int argc, char** args) {
+
+    if (argc < 2) {
+        printf("Usage: bench pivot [size] [pivots] [kernel] [threads]\n");
+        printf("       bench kernels [size] [pivots]\n");
+        printf("       bench check\n");
+        printf("       bench pricing [size] [problems] [scale]\n");
+        printf("       bench wide [rows] [columns] [window] [candidates]\n");
+        printf("       bench method [size] [problems] [share of >= rows] [cost]\n");
+        printf("       bench warm [size] [solves]\n");
+        printf("       bench presolve [size] [problems] [revised]\n");
+        printf("       bench scaling [size] [problems] [orders of magnitude] [revised]\n");
+        printf("       bench harris [size] [problems] [orders of magnitude] [noise] [revised]\n");
+        printf("       bench context [size] [problems] [revised]\n");
+        printf("       bench scenarios [size] [scenarios] [rhs|objective|mixed] [threads]\n");
+        printf("       bench ipm [largest size] [density]\n");
+        printf("       bench suite [--engine revised|ipm] [--repeats n] [--format table|csv|json] [--output file]\n");
+        printf("                   [--baseline file.csv] [--threshold 0.1] [--instance spec]...\n");
+        printf("       bench generate spec file\n");
+        return 0;
+    }
+
+    if (strcmp(args[1], "pivot") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 2000;
+        int count = argc > 3 ? atoi(args[3]) : 50;
+        if (!select_kernel(argc > 4 ? args[4] : "auto")) {
+            fprintf(stderr, "Kernel '%s' is not available\n", args[4]);
+            return 1;
+        }
+        pool_start(argc > 5 ? atoi(args[5]) : 1);
+        bench_pivot(n, count);
+        pool_stop();
+    } else if (strcmp(args[1], "pricing") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 100;
+        int count = argc > 3 ? atoi(args[3]) : 20;
+        double scale = argc > 4 ? atof(args[4]) : 4.0;
+        pool_start(1);
+        bench_pricing(n, count, scale);
+        pool_stop();
+    } else if (strcmp(args[1], "wide") == 0) {
+        int m = argc > 2 ? atoi(args[2]) : 200;
+        int n = argc > 3 ? atoi(args[3]) : 20000;
+        int window = argc > 4 ? atoi(args[4]) : 1000;
+        int candidates = argc > 5 ? atoi(args[5]) : 8;
+        pool_start(1);
+        bench_wide(m, n, window, candidates);
+        pool_stop();
+    } else if (strcmp(args[1], "method") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 120;
+        int count = argc > 3 ? atoi(args[3]) : 50;
+        double share = argc > 4 ? atof(args[4]) : 0.3;
+        bench_method(n, count, share, argc > 5 && strcmp(args[5], "cost") == 0);
+    } else if (strcmp(args[1], "scaling") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 100;
+        int count = argc > 3 ? atoi(args[3]) : 20;
+        double orders = argc > 4 ? atof(args[4]) : 8.0;
+        bench_scaling(n, count, orders, argc > 5 && strcmp(args[5], "revised") == 0);
+    } else if (strcmp(args[1], "harris") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 100;
+        int count = argc > 3 ? atoi(args[3]) : 20;
+        double orders = argc > 4 ? atof(args[4]) : 6.0;
+        double noise = argc > 5 ? atof(args[5]) : 1e-7;
+        bench_harris(n, count, orders, noise, argc > 6 && strcmp(args[6], "revised") == 0);
+    } else if (strcmp(args[1], "context") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 30;
+        int count = argc > 3 ? atoi(args[3]) : 2000;
+        bench_context(n, count, argc > 4 && strcmp(args[4], "revised") == 0);
+    } else if (strcmp(args[1], "presolve") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 60;
+        int count = argc > 3 ? atoi(args[3]) : 50;
+        bench_presolve(n, count, argc > 4 && strcmp(args[4], "revised") == 0);
+    } else if (strcmp(args[1], "warm") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 120;
+        int count = argc > 3 ? atoi(args[3]) : 50;
+        pool_start(1);
+        bench_warm(n, count);
+        pool_stop();
+    } else if (strcmp(args[1], "scenarios") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 150;
+        int count = argc > 3 ? atoi(args[3]) : 200;
+        bench_scenarios(n, count, argc > 4 ? args[4] : "mixed", argc > 5 ? atoi(args[5]) : 0);
+    } else if (strcmp(args[1], "ipm") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 400;
+        double density = argc > 3 ? atof(args[3]) : 0.5;
+        pool_start(0);
+        bench_ipm(n, density);
+        pool_stop();
+    } else if (strcmp(args[1], "suite") == 0) {
+        return bench_suite(argc - 2, args + 2);
+    } else if (strcmp(args[1], "generate") == 0) {
+        lp_spec spec = suite_instances[1];
+        if (argc < 4 || !parse_spec(args[2], &spec)) {
+            fprintf(stderr, "Usage: bench generate vars=..,rows=..,density=..,degeneracy=..,ge=..,eq=..,outcome=..,seed=.. file\n");
+            return 1;
+        }
+        linprog p = generate_lp(&spec);
+        int ok = write_text(&p, args[3]);
+        freelp(&p);
+        if (!ok) {
+            fprintf(stderr, "Failed to write '%s'.\n", args[3]);
+            return 1;
+        }
+    } else if (strcmp(args[1], "kernels") == 0) {
+        int n = argc > 2 ? atoi(args[2]) : 200;
+        int count = argc > 3 ? atoi(args[3]) : 50;
+        int failures = check_kernels(n, count);
+        printf("%i mismatches\n", failures);
+        return failures ? 1 : 0;
+    } else if (strcmp(args[1], "check") == 0) {
+        int failures = check_problems();
+        printf("%i mismatches\n", failures);
+        return failures ? 1 : 0;
+    } else {
+        fprintf(stderr, "Unknown benchmark '%s'\n", args[1]);
+        return 1;
+    }
+
+    return 0;
+
+}
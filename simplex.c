@@ -2,22 +2,95 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <time.h>
+
+// The vectorized kernels are compiled with per-function target attributes and picked at runtime
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLEX_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// Large pivots are split over a pool of POSIX threads, other platforms run single-threaded
+#ifndef _WIN32
+#define SIMPLEX_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// Solver statistics (see print_stats) are only collected when compiled with -DSIMPLEX_STATS, without it
+// the counters and timers compile to nothing
+#ifdef SIMPLEX_STATS
+#ifdef _MSC_VER
+#define SIMPLEX_THREAD_LOCAL __declspec(thread)
+#else
+#define SIMPLEX_THREAD_LOCAL _Thread_local
+#endif
+#endif
+
+// Problem files are memory mapped on POSIX systems and read in large chunks elsewhere
+#ifndef _WIN32
+#define SIMPLEX_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Get the current time in seconds.
+double now() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-// Grow an array to new size.
-void grow_array(void** target, size_t size, size_t elemSize, size_t newSize) {
-    
-    // Alloc new buffer
-    void* buffer = (void*) malloc(elemSize * newSize);
-    
-    // Copy of content and free old content
-    if (*target) {
-        memcpy(buffer, *target, elemSize * size);
-        free(*target);
+// Counters and timers of one solve, times are in seconds
+typedef struct {
+    double parse; // Reading the problem file
+    double presolve; // Presolve
+    double scale; // Scaling
+    double create; // Building the initial dictionary (the solver state of the revised engine)
+    double pricing; // Choosing the entering variable (the leaving row in the dual simplex method)
+    double ratio; // The ratio test (choosing the entering column in the dual simplex method)
+    double update; // Pivots, bound flips and refactorizations
+    double solve; // The whole solve, from the initial dictionary to the optimal one
+    double barrier; // The interior point method, up to the crossover
+    long iterations[2]; // Pivots and bound flips before and after a feasible basis of the problem is found
+    long degenerate; // Pivots and bound flips that did not move (a zero step)
+    long refactors; // Refactorizations of the basis (revised engine)
+    long steps; // Predictor-corrector steps of the interior point method
+    size_t peak; // The most memory held by tableaux (or LU factors and updates) at once, in bytes
+    int phase; // The index into 'iterations' of the current phase
+} solver_stats;
+
+#ifdef SIMPLEX_STATS
+// The statistics of the solve in progress on this thread
+SIMPLEX_THREAD_LOCAL solver_stats stats;
+#define STATS_CLOCK(t) double t = now()
+#define STATS_TIME(field, t) (stats.field += now() - (t))
+#define STATS_ADD(field, n) (stats.field += (n))
+#define STATS_ITERATION(zero) (stats.iterations[stats.phase]++, stats.degenerate += (zero) != 0)
+#define STATS_PHASE(p) (stats.phase = (p))
+#define STATS_PEAK(bytes) (stats.peak = (size_t)(bytes) > stats.peak ? (size_t)(bytes) : stats.peak)
+#else
+#define STATS_CLOCK(t) ((void)0)
+#define STATS_TIME(field, t) ((void)0)
+#define STATS_ADD(field, n) ((void)0)
+#define STATS_ITERATION(zero) ((void)0)
+#define STATS_PHASE(p) ((void)0)
+#define STATS_PEAK(bytes) ((void)0)
+#endif
+
+// Grow an array to new size, callers grow geometrically so that appends stay amortized constant time.
+// The elements are kept (realloc can often extend the block in place). Running out of memory is fatal.
+void grow_array(void** target, size_t elemSize, size_t newSize) {
+    void* buffer = realloc(*target, elemSize * newSize);
+    if (!buffer) {
+        fprintf(stderr, "Out of memory growing an array to %zu bytes\n", elemSize * newSize);
+        abort();
     }
-
-    // Update data
     *target = buffer;
-
 }
 
 // Represents a vector of real values
@@ -50,8 +123,8 @@ void vec_add(vector* a, vector* b) {
     }
 }
 
+// Copy the values of 'src' into 'dst', which must have the same size (no memory is allocated).
 void vec_copy(vector* src, vector* dst) {
-    *dst = vec(src->size);
     memcpy(dst->data, src->data, sizeof(double) * src->size);
 }
 
@@ -69,27 +142,154 @@ void print_vec(vector* v) {
     printf("]\n");
 }
 
-// Represents a NxM matrix of real values
+// Size in bytes of a cache line, used to align and pad matrix rows
+#define CACHE_LINE 64
+
+// Allocate a block of memory aligned to a cache line.
+void* aligned_malloc(size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size, CACHE_LINE);
+#else
+    void* p = 0;
+    if (posix_memalign(&p, CACHE_LINE, size) != 0)
+        return 0;
+    return p;
+#endif
+}
+
+// Free a block allocated with aligned_malloc.
+void aligned_free(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// A block taken from the heap after the arena of a context ran out, the data follows the header
+typedef struct overflow_block {
+    struct overflow_block* next; // The block taken before this one (0 if none)
+    char pad[CACHE_LINE - sizeof(void*)]; // Keeps the data aligned to a cache line
+} overflow_block;
+
+// Reusable solver memory: one arena that every tableau, scratch vector and index table of a solve is
+// carved from, released all at once by context_reset before the next problem. Requests that do not fit
+// go to the heap and are freed by the next reset, which also grows the arena to the largest amount a
+// problem has needed so far. A context may only be used by one thread at a time.
+typedef struct {
+    char* data; // The arena (aligned to a cache line)
+    size_t size; // The size of the arena in bytes
+    size_t used; // The amount of bytes handed out since the last reset
+    size_t peak; // The most bytes a single problem needed (overflow included)
+    size_t spilled; // The amount of bytes taken from the heap since the last reset
+    overflow_block* overflow; // The blocks taken from the heap since the last reset
+    long overflows; // The amount of requests that went to the heap over the lifetime of the context
+} simplex_context;
+
+// Get a context with an arena of 'size' bytes.
+simplex_context context(size_t size) {
+    simplex_context ctx;
+    ctx.data = size > 0 ? (char*)aligned_malloc(size) : 0;
+    ctx.size = ctx.data ? size : 0;
+    ctx.used = 0;
+    ctx.peak = 0;
+    ctx.spilled = 0;
+    ctx.overflow = 0;
+    ctx.overflows = 0;
+    return ctx;
+}
+
+// Allocate 'size' bytes aligned to a cache line, from the arena of 'ctx' or from the heap if 'ctx' is 0.
+void* context_alloc(simplex_context* ctx, size_t size) {
+    if (!ctx)
+        return aligned_malloc(size > 0 ? size : 1);
+    size = (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    if (size <= ctx->size - ctx->used) {
+        void* p = ctx->data + ctx->used;
+        ctx->used += size;
+        return p;
+    }
+    overflow_block* block = (overflow_block*)aligned_malloc(sizeof(overflow_block) + size);
+    if (!block)
+        return 0;
+    block->next = ctx->overflow;
+    ctx->overflow = block;
+    ctx->spilled += size;
+    ctx->overflows++;
+    return block + 1;
+}
+
+// Release memory from context_alloc, memory of an arena is only released by the next reset.
+void context_release(simplex_context* ctx, void* p) {
+    if (!ctx)
+        aligned_free(p);
+}
+
+// Release everything handed out by a context and make sure the arena has at least 'size' bytes for the
+// next problem (and as many as the largest problem so far needed).
+void context_reset(simplex_context* ctx, size_t size) {
+    size_t needed = ctx->used + ctx->spilled;
+    if (needed > ctx->peak)
+        ctx->peak = needed;
+    while (ctx->overflow) {
+        overflow_block* next = ctx->overflow->next;
+        aligned_free(ctx->overflow);
+        ctx->overflow = next;
+    }
+    if (size < ctx->peak)
+        size = ctx->peak;
+    if (size > ctx->size) {
+        aligned_free(ctx->data);
+        ctx->data = (char*)aligned_malloc(size);
+        ctx->size = ctx->data ? size : 0;
+    }
+    ctx->used = 0;
+    ctx->spilled = 0;
+}
+
+void freecontext(simplex_context* ctx) {
+    context_reset(ctx, 0);
+    aligned_free(ctx->data);
+    ctx->data = 0;
+    ctx->size = 0;
+}
+
+// Represents a NxM matrix of real values.
+// The values are kept in one contiguous row-major block where every row starts on a cache line.
 typedef struct {
     int columns; // The amount of columns (M)
     int rows; // The amount of rows (N)
-    vector* data; // The matrix values.
+    int stride; // The amount of doubles from the start of one row to the start of the next
+    double* data; // The matrix values.
 } matrix;
 
-matrix mat(int r, int c) {
+// Get the stride (in doubles) of a row with 'c' columns padded to a whole cache line.
+int mat_stride(int c) {
+    int perLine = CACHE_LINE / sizeof(double);
+    return ((c + perLine - 1) / perLine) * perLine;
+}
+
+// Get a 'r' x 'c' matrix from the arena of 'ctx' (from the heap if 'ctx' is 0).
+matrix mat_in(simplex_context* ctx, int r, int c) {
     matrix m;
     m.columns = c;
     m.rows = r;
-    m.data = (vector*)malloc(sizeof(vector) * r);
-    for (int i = 0; i < r; i++)
-        m.data[i] = vec(c);
+    m.stride = mat_stride(c);
+    m.data = (double*)context_alloc(ctx, sizeof(double) * (size_t)m.stride * (r > 0 ? r : 1));
     return m;
 }
 
+matrix mat(int r, int c) {
+    return mat_in(0, r, c);
+}
+
+// Get a pointer to the first element of row 'i'.
+double* mat_row(matrix* m, int i) {
+    return m->data + (size_t)i * m->stride;
+}
+
 void freemat(matrix* m) {
-    for (int i = 0; i < m->rows; i++)
-        freevec(&m->data[i]);
-    free(m->data);
+    aligned_free(m->data);
 }
 
 // Add 'r' rows to an existing matrix.
@@ -105,35 +305,404 @@ void mat_addrows(matrix* mat, int r, vector* rows) {
         return;
     }
 
-    // Grab new row array and copy data
-    vector* newRows = (vector*)malloc(sizeof(vector) * (r + mat->rows));
-    memcpy(newRows, mat->data, sizeof(vector) * mat->rows);
-    memcpy(newRows + mat->rows, rows, sizeof(vector) * r);
+    // Grab new block and copy data
+    double* block = (double*)aligned_malloc(sizeof(double) * (size_t)mat->stride * (r + mat->rows));
+    memcpy(block, mat->data, sizeof(double) * (size_t)mat->stride * mat->rows);
+    for (int i = 0; i < r; i++)
+        memcpy(block + (size_t)(mat->rows + i) * mat->stride, rows[i].data, sizeof(double) * mat->columns);
 
     // Free old
-    free(mat->data);
+    aligned_free(mat->data);
 
     // Update matrix
-    mat->data = newRows;
+    mat->data = block;
     mat->rows += r;
 
 }
 
 void print_matrix(matrix m) {
     for (int i = 0; i < m.rows; i++) {
+        double* row = mat_row(&m, i);
         for (int j = 0; j < m.columns; j++) {
-            printf("|%8.4f ", m.data[i].data[j]);
+            printf("|%8.4f ", row[j]);
         }
         printf("\n");
     }
 }
 
+// Represents a sparse NxM matrix in compressed sparse column form.
+// Repeated entries of the same row and column are summed by every user.
+typedef struct {
+    int columns; // The amount of columns (M)
+    int rows; // The amount of rows (N)
+    int nnz; // The amount of stored entries
+    int* start; // Column 'j' is stored in entries start[j] to start[j + 1] - 1
+    int* index; // The row of every entry
+    double* value; // The value of every entry
+} spmatrix;
+
+// A growable list of (row, column, value) triplets used to build sparse matrices
+typedef struct {
+    int nnz; // The amount of triplets
+    int cap; // The amount of triplets that fit before growing
+    int* row; // The row of every triplet
+    int* col; // The column of every triplet
+    double* value; // The value of every triplet
+} triplets;
+
+// Get an empty triplet list with room for 'cap' triplets.
+triplets trip(int cap) {
+    triplets t;
+    t.nnz = 0;
+    t.cap = cap > 0 ? cap : 1;
+    t.row = (int*)malloc(sizeof(int) * t.cap);
+    t.col = (int*)malloc(sizeof(int) * t.cap);
+    t.value = (double*)malloc(sizeof(double) * t.cap);
+    return t;
+}
+
+// Append a triplet, doubling the capacity when full (up to INT_MAX triplets, the limit of a sparse matrix).
+void trip_add(triplets* t, int r, int c, double v) {
+    if (t->nnz == t->cap) {
+        if (t->cap == INT_MAX) {
+            fprintf(stderr, "Attempt to store more than %i nonzeros in a sparse matrix\n", INT_MAX);
+            exit(-1);
+        }
+        int cap = t->cap <= INT_MAX / 2 ? t->cap * 2 : INT_MAX;
+        grow_array((void**)&t->row, sizeof(int), cap);
+        grow_array((void**)&t->col, sizeof(int), cap);
+        grow_array((void**)&t->value, sizeof(double), cap);
+        t->cap = cap;
+    }
+    t->row[t->nnz] = r;
+    t->col[t->nnz] = c;
+    t->value[t->nnz++] = v;
+}
+
+void freetrip(triplets* t) {
+    free(t->row);
+    free(t->col);
+    free(t->value);
+}
+
+// Create a 'r' x 'c' sparse matrix from a list of triplets.
+spmatrix sp_from_triplets(int r, int c, triplets* t) {
+
+    int nnz = t->nnz;
+    int* ri = t->row;
+    int* ci = t->col;
+    double* v = t->value;
+
+    spmatrix m;
+    m.rows = r;
+    m.columns = c;
+    m.nnz = nnz;
+    m.start = (int*)calloc((size_t)c + 1, sizeof(int));
+    m.index = (int*)malloc(sizeof(int) * (nnz > 0 ? nnz : 1));
+    m.value = (double*)malloc(sizeof(double) * (nnz > 0 ? nnz : 1));
+
+    // Count entries per column and turn the counts into offsets
+    for (int k = 0; k < nnz; k++)
+        m.start[ci[k] + 1]++;
+    for (int j = 0; j < c; j++)
+        m.start[j + 1] += m.start[j];
+
+    // Scatter, triplets given in row order stay in row order within their column
+    int* next = (int*)malloc(sizeof(int) * (c > 0 ? c : 1));
+    memcpy(next, m.start, sizeof(int) * c);
+    for (int k = 0; k < nnz; k++) {
+        int at = next[ci[k]]++;
+        m.index[at] = ri[k];
+        m.value[at] = v[k];
+    }
+    free(next);
+
+    // Sum repeated entries of a row, which are adjacent within their column for triplets in row order
+    int kept = 0;
+    for (int j = 0; j < c; j++) {
+        int begin = m.start[j], end = m.start[j + 1];
+        m.start[j] = kept;
+        for (int k = begin; k < end; k++) {
+            if (kept > m.start[j] && m.index[kept - 1] == m.index[k]) {
+                m.value[kept - 1] += m.value[k];
+            } else {
+                m.index[kept] = m.index[k];
+                m.value[kept++] = m.value[k];
+            }
+        }
+    }
+    m.start[c] = kept;
+    m.nnz = kept;
+
+    return m;
+
+}
+
+void freesp(spmatrix* m) {
+    free(m->start);
+    free(m->index);
+    free(m->value);
+}
+
+// Only print the result of every problem
+#define VERBOSITY_QUIET 0
+
+// Also print a one line summary per iteration
+#define VERBOSITY_NORMAL 1
+
+// Also print every dictionary
+#define VERBOSITY_TRACE 2
+
+// The size of the output buffer of a writer
+#define WRITER_BUFFER (1 << 20)
+
+// Buffered output for solver logs and results
+typedef struct {
+    FILE* file; // Where the buffer is flushed to (0 keeps all output in memory)
+    char* data; // The buffered output
+    size_t size; // The amount of buffered bytes
+    size_t cap; // The size of the buffer
+    int level; // The verbosity level (VERBOSITY_*)
+} writer;
+
+// Get a writer flushing to 'file' with the given verbosity level.
+writer wr(FILE* file, int level) {
+    writer w;
+    w.file = file;
+    w.cap = file ? WRITER_BUFFER : 4096;
+    w.data = (char*)malloc(w.cap);
+    w.size = 0;
+    w.level = level;
+    return w;
+}
+
+// Write all buffered output to the file.
+void wr_flush(writer* w) {
+    if (!w->file)
+        return; // In memory
+    if (w->size > 0)
+        fwrite(w->data, 1, w->size, w->file);
+    w->size = 0;
+}
+
+void freewr(writer* w) {
+    wr_flush(w);
+    free(w->data);
+}
+
+// Append formatted output, flushing when the buffer is full (or growing it for an in memory writer).
+void wr_printf(writer* w, const char* format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(w->data + w->size, w->cap - w->size, format, args);
+        va_end(args);
+        if (n < 0)
+            return;
+        if ((size_t)n < w->cap - w->size) {
+            w->size += n;
+            return;
+        }
+        if (w->file && w->size > 0) {
+            wr_flush(w);
+        } else {
+            // Grow for in memory output or a single line larger than the buffer
+            size_t cap = w->cap * 2 > w->size + n + 1 ? w->cap * 2 : w->size + n + 1;
+            grow_array((void**)&w->data, 1, cap);
+            w->cap = cap;
+        }
+    }
+}
+
+// Partial and multiple pricing settings shared by both engines
+typedef struct {
+    int window; // Columns priced per iteration before settling on the best one so far (0 prices every column)
+    int candidates; // Columns kept from every scan and priced alone in the next iterations (0 keeps none)
+} pricing_options;
+
+// The pricing settings (set from the command line)
+pricing_options pricing_opts = { 0, 0 };
+
+// Pricing state of a solve: where the next partial scan starts and the candidate list of multiple pricing
+typedef struct {
+    int offset; // The column the next scan starts at
+    int count; // The amount of candidates
+    int* list; // The candidate columns, best first
+    double* score; // The score of every candidate when it was found
+    simplex_context* ctx; // Where the candidate list is allocated (0 for the heap), not owned
+} price_state;
+
+void price_init(price_state* s, simplex_context* ctx) {
+    s->offset = 0;
+    s->count = 0;
+    s->list = 0;
+    s->score = 0;
+    s->ctx = ctx;
+}
+
+void price_free(price_state* s) {
+    if (s->list) {
+        context_release(s->ctx, s->list);
+        context_release(s->ctx, s->score);
+    }
+}
+
+// Keep column 'j' if it is among the best 'pricing_opts.candidates' columns seen in the scan.
+void price_keep(price_state* s, int j, double score) {
+    int cap = pricing_opts.candidates;
+    if (!s->list) {
+        s->list = (int*)context_alloc(s->ctx, sizeof(int) * cap);
+        s->score = (double*)context_alloc(s->ctx, sizeof(double) * cap);
+    }
+    if (s->count == cap && score <= s->score[cap - 1])
+        return;
+    int i = s->count < cap ? s->count++ : cap - 1;
+    for (; i > 0 && s->score[i - 1] < score; i--) {
+        s->list[i] = s->list[i - 1];
+        s->score[i] = s->score[i - 1];
+    }
+    s->list[i] = j;
+    s->score[i] = score;
+}
+
+// Get the entering column among [lo, hi] by the largest positive score, -1 if no column has one.
+// With candidates left from an earlier scan only they are priced (a minor iteration). Otherwise the
+// columns are scanned from where the last scan stopped, 'window' at a time, until one has a positive
+// score; columns in the window with a positive score become the new candidates.
+int price_scan(price_state* s, int lo, int hi, double (*score)(void* ctx, int j), void* ctx) {
+
+    int best = -1;
+    double bestScore = 0;
+
+    // Minor iteration: price the remaining candidates, dropping those that are no longer attractive
+    if (s->count > 0) {
+        int kept = 0;
+        for (int i = 0; i < s->count; i++) {
+            double v = score(ctx, s->list[i]);
+            if (v <= 0)
+                continue;
+            if (v > bestScore) {
+                best = s->list[i];
+                bestScore = v;
+            }
+            s->list[kept] = s->list[i];
+            s->score[kept++] = v;
+        }
+        s->count = kept;
+    }
+
+    // Scan the columns, one window at a time
+    if (best == -1) {
+        s->count = 0;
+        int total = hi - lo + 1;
+        int window = pricing_opts.window > 0 && pricing_opts.window < total ? pricing_opts.window : total;
+        int j = s->offset >= lo && s->offset <= hi ? s->offset : lo;
+        for (int scanned = 0; scanned < total && best == -1; ) {
+            int chunk = window < total - scanned ? window : total - scanned;
+            for (int k = 0; k < chunk; k++) {
+                double v = score(ctx, j);
+                if (v > 0) {
+                    if (v > bestScore) {
+                        best = j;
+                        bestScore = v;
+                    }
+                    if (pricing_opts.candidates > 0)
+                        price_keep(s, j, v);
+                }
+                j = j == hi ? lo : j + 1;
+            }
+            scanned += chunk;
+        }
+        s->offset = j;
+    }
+
+    // The entering column leaves the candidate list
+    for (int i = 0; i < s->count; i++) {
+        if (s->list[i] == best) {
+            memmove(s->list + i, s->list + i + 1, sizeof(int) * (s->count - i - 1));
+            memmove(s->score + i, s->score + i + 1, sizeof(double) * (s->count - i - 1));
+            s->count--;
+            break;
+        }
+    }
+    return best;
+
+}
+
+// Constraint types
+#define SENSE_LE -1
+#define SENSE_EQ 0
+#define SENSE_GE 1
+
+// Bounds of the decision variables of a problem, each of them can be infinite
+typedef struct {
+    double* lower; // The lower bound of every decision variable
+    double* upper; // The upper bound of every decision variable
+} var_bounds;
+
+// The form of a variable in a dictionary with bounded variables: its value is offset + sign * x for the
+// variable x of the dictionary, which goes from 0 up to 'upper'. Bound flips switch between x and upper - x.
+typedef struct {
+    double upper; // The upper bound of x (INFINITY if none)
+    double offset; // The value of the variable at x = 0
+    signed char sign; // 1 or -1
+    char free; // Set if x has no bounds at all (it never leaves the basis)
+} var_form;
+
+// A column removed by presolve (an entry of the postsolve stack)
+typedef struct {
+    int column; // The column in the original problem
+    double value; // The value the column was fixed at
+} postsolve_step;
+
+// What presolve removed from a problem, used to map the solution of the reduced problem back to it
+typedef struct {
+    int rows; // The amount of rows of the original problem
+    int columns; // The amount of columns of the original problem
+    int* rowMap; // The original row of every row of the reduced problem
+    int* columnMap; // The original column of every column of the reduced problem
+    int keptRows; // The amount of rows of the reduced problem
+    postsolve_step* stack; // The removed columns, in the order they were removed
+    int count; // The amount of removed columns
+    double offset; // The objective value of the removed columns
+    int empty, singleton, duplicate; // The amount of rows removed by every reduction
+    int fixed, dominated; // The amount of columns removed by every reduction
+    double time; // The time presolve took (seconds)
+    spmatrix* a; // The constraints of the original problem (which has to outlive the solution)
+    double* b; // The bounds of the original problem
+} postsolve;
+
+// Tolerance of presolve: rows and bounds that agree up to it (relative to their size) count as equal
+#define PRESOLVE_EPS 1e-9
+
+// The factors a problem was scaled with: row i of A and b is multiplied by row[i] and column j of A and c
+// by column[j], so x_j of the scaled problem is x_j / column[j] of the original one
+typedef struct {
+    double* row; // The factor of every row
+    double* column; // The factor of every column
+    double* unscale; // The factor that takes every variable back to the original problem (by variable)
+    int passes; // The amount of geometric mean passes made
+    double before; // The ratio of the largest and smallest magnitude in A before scaling
+    double after; // The same ratio after scaling
+} scaling;
+
 // Represents a dictionary in the simplex method.
 typedef struct {
     matrix dic; // The dictionary contents
-    unsigned char* vars; // The variable indices at the given positions
+    int* vars; // The variable indices at the given positions
     int varc; // The amount of decision variables
     int state; // The current state of the dictionary
+    writer* out; // Where logs and results are written
+    double* weights; // The pricing weights of the columns (0 until the pricing rule sets them up)
+    int iterations; // The amount of pivots made
+    price_state price; // Partial and multiple pricing state
+    int bland; // Set while Bland's rule is used to leave a degenerate vertex
+    double* perturb; // The bound perturbation of every row in terms of the current basis (0 if unperturbed)
+    char* fixed; // Set for the slack variables of equality rows (by variable), which must stay at zero (0 without equalities)
+    var_form* forms; // The form of every variable (by variable), 0 if all of them are in [0, inf)
+    postsolve* post; // Maps the solution back to the problem before presolve (0 if not presolved), not owned
+    scaling* scale; // Takes the solution back to the problem before scaling (0 if not scaled), not owned
+    simplex_context* ctx; // Where the memory of the dictionary comes from (0 for the heap), not owned
 } dictionary;
 
 // Simplex state when terminating in an optimal state
@@ -148,81 +717,209 @@ typedef struct {
 // Simplex state when the current dictionary is feasible
 #define SIMPLEX_STATE_FEASIBLE 1
 
-dictionary create_dic(vector* c, vector* b, matrix* a) {
+// Simplex state when the iteration limit was reached before the problem was solved
+#define SIMPLEX_STATE_ITERATION_LIMIT -3
+
+// Degeneracy handling settings shared by both engines
+typedef struct {
+    int stall; // Consecutive degenerate pivots before falling back to Bland's rule (0 never falls back)
+    double perturb; // Relative size of the bound perturbation applied instead on the first stall (0 never perturbs)
+    long maxIterations; // Pivots allowed per phase (0 picks 50 times the amount of rows and columns, plus 1000)
+} degeneracy_options;
+
+// The degeneracy settings (set from the command line)
+degeneracy_options degeneracy_opts = { 50, 0, 0 };
+
+// Get the iteration limit of a phase on a problem with 'rows' rows and 'columns' columns.
+long iteration_limit(int rows, int columns) {
+    return degeneracy_opts.maxIterations > 0 ? degeneracy_opts.maxIterations : 50L * (rows + columns) + 1000;
+}
+
+// Tolerance of the tableau engine: smaller objective coefficients count as zero and a smaller auxiliary
+// objective still counts as feasible after phase one
+#define SIMPLEX_EPS 1e-9
+
+// Ratio test tolerances shared by both engines
+typedef struct {
+    double primal; // Bound violation allowed to a basic variable by the first pass of the Harris ratio test
+    double pivot; // Smaller entries of the entering column never become pivots
+    int harris; // Use the Harris two-pass ratio test (the textbook ratio test if 0)
+} tolerance_options;
+
+// The tolerance settings (set from the command line)
+tolerance_options tolerance_opts = { 1e-9, 1e-9, 0 };
+
+// Get a cleared table of 'size' fixed flags for a dictionary.
+char* alloc_fixed(dictionary* d, size_t size) {
+    char* fixed = (char*)context_alloc(d->ctx, size);
+    memset(fixed, 0, size);
+    return fixed;
+}
+
+// Create the initial dictionary of maximizing c'x subject to Ax <= b, or Ax = b for the rows whose
+// 'sense' is SENSE_EQ ('sense' may be 0 if there are no equalities). Every row gets a slack variable;
+// those of equality rows are fixed at zero and have to be pivoted out (see drive_out_equalities).
+// With 'vb' (0 if every variable is in [0, inf)) each decision variable starts at its lower bound, or at
+// its upper bound (in the form upper - x) if it has no lower bound; variables with equal bounds are fixed.
+// All memory of the dictionary comes from 'ctx' (the heap if 0).
+dictionary create_dic(vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb, simplex_context* ctx) {
 
     // Dictionary to be formed from input
+    STATS_CLOCK(start);
     dictionary d;
     d.varc = c->size;
-    d.dic = mat(b->size + 1, c->size + 1);
+    d.ctx = ctx;
+    d.dic = mat_in(ctx, b->size + 1, c->size + 1);
+    STATS_PEAK(sizeof(double) * d.dic.stride * d.dic.rows);
     d.state = SIMPLEX_STATE_FEASIBLE;
+    d.out = 0;
+    d.weights = 0;
+    d.iterations = 0;
+    price_init(&d.price, ctx);
+    d.bland = 0;
+    d.perturb = 0;
+    d.post = 0;
+    d.scale = 0;
+    d.fixed = 0;
+    for (int i = 0; i < b->size && sense; i++) {
+        if (sense[i] == SENSE_EQ) {
+            if (!d.fixed)
+                d.fixed = alloc_fixed(&d, (size_t)c->size + b->size + 1);
+            d.fixed[c->size + 1 + i] = 1;
+        }
+    }
+    d.forms = 0;
 
     // Init basics
-    d.dic.data[0].data[0] = 0;
+    double* obj = mat_row(&d.dic, 0);
+    obj[0] = 0;
 
     // Init objective row
     for (int i = 0; i < c->size; i++){
-        d.dic.data[0].data[i+1] = c->data[i];
+        obj[i+1] = c->data[i];
     }
 
     // Init nonbasic
     for (int i = 0; i < b->size; i++){
-        d.dic.data[i + 1].data[0] = b->data[i];
-        for (int j = 0; j < c->size; j++) {
-            d.dic.data[i + 1].data[j + 1] = -a->data[i].data[j];
+        double* row = mat_row(&d.dic, i + 1);
+        row[0] = b->data[i];
+        memset(row + 1, 0, sizeof(double) * c->size);
+    }
+    for (int j = 0; j < c->size; j++) {
+        for (int k = a->start[j]; k < a->start[j + 1]; k++) {
+            mat_row(&d.dic, a->index[k] + 1)[j + 1] -= a->value[k];
         }
     }
 
     // alloc name
-    d.vars = (unsigned char*)malloc(sizeof(unsigned char) * (c->size + b->size));
-    for (unsigned char i = 0; i < c->size + b->size; i++) {
+    d.vars = (int*)context_alloc(ctx, sizeof(int) * ((size_t)c->size + b->size));
+    for (int i = 0; i < c->size + b->size; i++) {
         d.vars[i] = i + 1;
     }
 
+    // Move the decision variables to their bounds
+    if (vb) {
+        d.forms = (var_form*)context_alloc(ctx, sizeof(var_form) * ((size_t)c->size + b->size + 1));
+        for (int v = 0; v <= c->size + b->size; v++) {
+            var_form f = { INFINITY, 0, 1, 0 };
+            d.forms[v] = f;
+        }
+        for (int j = 0; j < c->size; j++) {
+            double l = vb->lower[j], u = vb->upper[j];
+            var_form* f = &d.forms[j + 1];
+            if (l > -INFINITY) {
+                f->offset = l;
+                f->upper = u - l;
+            } else if (u < INFINITY) {
+                f->offset = u;
+                f->sign = -1;
+            } else {
+                f->free = 1;
+            }
+            if (f->upper == 0) {
+                if (!d.fixed)
+                    d.fixed = alloc_fixed(&d, (size_t)c->size + b->size + 1);
+                d.fixed[j + 1] = 1;
+            }
+            for (int i = 0; i < b->size + 1; i++) {
+                double* row = mat_row(&d.dic, i);
+                row[0] += f->offset * row[j + 1];
+                row[j + 1] *= f->sign;
+            }
+        }
+    }
+
     // Return the created dictionary
+    STATS_TIME(create, start);
     return d;
 
 }
 
-void get_var(dictionary* dic, char n[5], int v) {
-    if (v <= dic->varc)
-        sprintf(n, "x%i", v);
+// Release a part of a dictionary (which may be 0).
+void dic_release(dictionary* d, void* p) {
+    if (p)
+        context_release(d->ctx, p);
+}
+
+void freedic(dictionary* d) {
+    dic_release(d, d->dic.data);
+    dic_release(d, d->vars);
+    dic_release(d, d->weights);
+    price_free(&d->price);
+    dic_release(d, d->perturb);
+    dic_release(d, d->fixed);
+    dic_release(d, d->forms);
+}
+
+// The size of a buffer for a variable name (a letter and any 32-bit index)
+#define VAR_NAME_SIZE 16
+
+// Get the name of variable 'v' in a problem with 'varc' decision variables ('n' holds VAR_NAME_SIZE chars).
+void var_name(int varc, char* n, int v) {
+    if (v <= varc)
+        snprintf(n, VAR_NAME_SIZE, "x%i", v);
     else 
-        sprintf(n, "w%i", v - dic->varc);
+        snprintf(n, VAR_NAME_SIZE, "w%i", v - varc);
+}
+
+void get_var(dictionary* dic, char* n, int v) {
+    var_name(dic->varc, n, v);
 }
 
 void print_dictionary(dictionary* dic) {
 
     // Print header (names of non-basics)
-    printf("%34s  ", "");
+    wr_printf(dic->out, "%34s  ", "");
     for (int i = 0; i < dic->varc; i++) {
-        char n[5];
+        char n[VAR_NAME_SIZE];
         get_var(dic, n, dic->vars[i]);
-        printf("%16s  ", n);
+        wr_printf(dic->out, "%16s  ", n);
     }
-    printf("\n");
+    wr_printf(dic->out, "\n");
 
     // Print basics
     for (int i = 0; i < dic->dic.rows; i++) {
         if (i > 0) {
-            char n[5];
+            char n[VAR_NAME_SIZE];
             get_var(dic, n, dic->vars[dic->varc - 1 + i]);
-            printf("%16s =", n);
+            wr_printf(dic->out, "%16s =", n);
         } else {
-            printf("%16s =", "Zeta");
+            wr_printf(dic->out, "%16s =", "Zeta");
         }
+        double* row = mat_row(&dic->dic, i);
         for (int j = 0; j < dic->dic.columns; j++) {
-            double v = dic->dic.data[i].data[j];
+            double v = row[j];
             if (j > 0) {
                 if (v <= 0) {
-                    printf("-");
+                    wr_printf(dic->out, "-");
                     v = -v;
                 } else {
-                    printf("+");
+                    wr_printf(dic->out, "+");
                 }
             }
-            printf("%16.4f ", v);
+            wr_printf(dic->out, "%16.4f ", v == 0 ? 0.0 : v);
         }
-        printf("\n");
+        wr_printf(dic->out, "\n");
     }
 
 }
@@ -236,39 +933,27 @@ void eliminate_column(dictionary* dic, int column) {
     // If last column, we can resize
     if (column == dic->dic.columns - 2) {
 
-        // Create new matrix
-        matrix m = mat(dic->dic.rows, dic->dic.columns - 1);
-        for (int i = 0; i < dic->dic.rows; i++) {
-            for (int j = 0; j < dic->dic.columns - 1; j++) {
-                m.data[i].data[j] = dic->dic.data[i].data[j];
-            }
-        }
+        // Drop the last column, the row stride stays the same so no data has to move
+        dic->dic.columns -= 1;
 
-        // Alloc new vars table
-        unsigned char* vs = malloc(sizeof(unsigned char) * (dic->varc - 1 + dic->dic.rows - 1));
+        // Drop its entry from the vars table in place and renumber the variables after it
+        int* vs = dic->vars;
         for (int i = 0; i < dic->varc - 1; i++)
-            vs[i] = dic->vars[i] - (dic->vars[i] > (dic->varc - 1) ? 1 : 0);
+            vs[i] = vs[i] - (vs[i] > (dic->varc - 1) ? 1 : 0);
         for (int i = dic->varc - 1; i < dic->varc - 1 + dic->dic.rows - 1; i++)
-            vs[i] = dic->vars[i + 1] - (dic->vars[i + 1] > (dic->varc - 1) ? 1 : 0);
-
-        // free old matrix
-        freemat(&dic->dic);
-
-        // Free old vars
-        free(dic->vars);
+            vs[i] = vs[i + 1] - (vs[i + 1] > (dic->varc - 1) ? 1 : 0);
 
         // update
-        dic->dic = m;
         dic->varc -= 1;
-        dic->vars = vs;
 
     } else {
 
         // Move column closer to end
         for (int i = 0; i < dic->dic.rows; i++) {
-            double tmp = dic->dic.data[i].data[column + 1];
-            dic->dic.data[i].data[column + 1] = dic->dic.data[i].data[column+2];
-            dic->dic.data[i].data[column+2] = tmp;
+            double* row = mat_row(&dic->dic, i);
+            double tmp = row[column + 1];
+            row[column + 1] = row[column + 2];
+            row[column + 2] = tmp;
         }
 
         // Fix vars
@@ -283,215 +968,831 @@ void eliminate_column(dictionary* dic, int column) {
 
 }
 
-int index_of(unsigned char* arr, unsigned char val, int min, int max) {
+// Get the position of variable 'val' among arr[min] to arr[max - 1], -1 if it is not there.
+int index_of(int* arr, int val, int min, int max) {
     for (int i = min; i < max; i++){
         if (arr[i] == val)
-            return arr[i];
+            return i;
     }
     return -1;
 }
 
-int find_pivot(matrix* dic, int* enter, int* leave) {
+// Get how far the basic variable of row 'i' is outside its bounds (0 if it is within them).
+double infeasibility(dictionary* d, int i) {
+    double x = mat_row(&d->dic, i)[0];
+    if (!d->forms)
+        return x < 0 ? -x : 0;
+    var_form* f = &d->forms[d->vars[d->varc + i - 1]];
+    return f->free ? 0 : x < 0 ? -x : x > f->upper ? x - f->upper : 0;
+}
 
-    // Find largest positive coefficient (entering)
-    *enter = -1;
-    for (int i = 1; i < dic->data[0].size; i++){
-        if (dic->data[0].data[i] > 0){
-            if (*enter == -1)
-                *enter = i;
-            else
-                *enter = dic->data[0].data[i] > dic->data[0].data[*enter] ? i : *enter;
-        }
-    }
+// Check if the nonbasic variable of column 'j' is fixed at zero (the slack of an equality row), it never enters.
+int is_fixed(dictionary* d, int j) {
+    return d->fixed && d->fixed[d->vars[j - 1]];
+}
 
-    // Return if none is found
-    if (*enter == -1)
-        return SIMPLEX_STATE_SUCCESS; // No positive coefficent, we're done
+// Get the upper bound of variable 'v' in its current form.
+double var_upper(dictionary* d, int v) {
+    return d->forms ? d->forms[v].upper : INFINITY;
+}
 
-    // Find smallest constraint (leaving)
-    *leave = -1;
-    double minRatio = INFINITY;
-    for (int i = 1; i < dic->rows; i++){
-        double num = dic->data[i].data[0];
-        double den = dic->data[i].data[*enter];
-        if (den == 0 && num != 0)
-            continue; // Avoid a division by 0
-        double ratio = num == 0 && den == 0 ? 0 : (num / -den);
-        if (ratio < minRatio && ratio >= 0) {
-            minRatio = ratio;
-            *leave = i;
-        }
+// Check if variable 'v' is free.
+int is_free(dictionary* d, int v) {
+    return d->forms && d->forms[v].free;
+}
+
+// Get the value of variable 'v' when its dictionary variable is 'x'.
+double var_value(dictionary* d, int v, double x) {
+    return d->forms ? d->forms[v].offset + d->forms[v].sign * x : x;
+}
+
+// Switch the nonbasic variable of column 'j' to its other form (x to upper - x, or x to -x if it is free),
+// which moves it to its other bound.
+void flip_column(dictionary* d, int j) {
+    var_form* f = &d->forms[d->vars[j - 1]];
+    double u = f->free ? 0 : f->upper;
+    for (int i = 0; i < d->dic.rows; i++) {
+        double* row = mat_row(&d->dic, i);
+        row[0] += u * row[j];
+        row[j] = -row[j];
     }
+    f->offset += f->sign * u;
+    f->sign = -f->sign;
+}
 
-    // Verify
-    if (*leave == -1)
-        return SIMPLEX_STATE_UNBOUNDED; // Unbounded
+// Switch the basic variable of row 'r' to the form upper - x, so that reaching its upper bound
+// becomes reaching zero.
+void flip_row(dictionary* d, int r) {
+    var_form* f = &d->forms[d->vars[d->varc + r - 1]];
+    double* row = mat_row(&d->dic, r);
+    row[0] = f->upper - row[0];
+    for (int j = 1; j < d->dic.columns; j++)
+        row[j] = -row[j];
+    if (d->perturb)
+        d->perturb[r] = -d->perturb[r];
+    f->offset += f->sign * f->upper;
+    f->sign = -f->sign;
+}
 
-    // Return 1 ==> Pivot found
-    return SIMPLEX_STATE_FEASIBLE;
+// Get how far the entering variable of column 'e' can increase before the basic variable of row 'i'
+// goes 'relax' beyond one of its bounds (INFINITY if never).
+double row_ratio(dictionary* d, int i, int e, double relax) {
+    double* row = mat_row(&d->dic, i);
+    double den = row[e];
+    if (den <= -tolerance_opts.pivot)
+        return d->forms && d->forms[d->vars[d->varc + i - 1]].free ? INFINITY : (row[0] + relax) / -den;
+    if (den >= tolerance_opts.pivot && d->forms)
+        return (d->forms[d->vars[d->varc + i - 1]].upper - row[0] + relax) / den; // Infinite without an upper bound
+    return INFINITY; // The basic variable does not decrease, or the entry is too small to pivot on
+}
+
+// The maximum amount of threads in the pool
+#define MAX_THREADS 256
+
+// Task run by the thread pool on the rows [begin, end), 'block' is the index of the calling thread.
+typedef void (*pool_task)(void* arg, int block, int begin, int end);
 
+// A persistent pool of worker threads, each task is split into one block per thread.
+typedef struct {
+    int threads; // The amount of threads sharing a task (including the calling thread)
+    long threshold; // The amount of tableau cells below which work stays on the calling thread
+#ifdef SIMPLEX_THREADS
+    pthread_t workers[MAX_THREADS]; // The worker threads (1 to threads - 1)
+    pthread_mutex_t lock; // Guards the fields below
+    pthread_cond_t wake; // Signalled when a task is posted or the pool stops
+    pthread_cond_t finished; // Signalled when the last worker is done with its block
+    unsigned long generation; // Incremented for every posted task
+    int pending; // The amount of workers still working on the current task
+    int stop; // Set when the workers should exit
+    int busy; // Set while a task runs, tasks started meanwhile (from inside a task) stay on their thread
+    pool_task task; // The current task
+    void* arg; // The argument of the current task
+    int n; // The amount of rows in the current task
+#endif
+} thread_pool;
+
+// The pool used by pivot and find_pivot, the threads and their synchronization are set up by pool_start
+thread_pool pool = { .threads = 1, .threshold = 1 << 18 };
+
+// Run block 'block' of a task over 'n' rows.
+void pool_block(pool_task task, void* arg, int block, int n) {
+    int begin = (int)((long long)n * block / pool.threads);
+    int end = (int)((long long)n * (block + 1) / pool.threads);
+    if (begin < end)
+        task(arg, block, begin, end);
 }
 
-int most_infeasible(matrix* dic, int enter) {
-    int leave = 1;
-    double maxRatio = -INFINITY;
-    for (int i = 1; i < dic->rows; i++){
-        double num = dic->data[i].data[0];
-        double den = dic->data[i].data[enter];
-        if (den == 0 && num != 0)
-            continue; // Avoid a division by 0
-        double ratio = num == 0 && den == 0 ? 0 : (num / -den);
-        if (ratio > maxRatio && ratio >= 0) {
-            maxRatio = ratio;
-            leave = i;
+#ifdef SIMPLEX_THREADS
+
+// Main loop of a worker thread, 'p' holds the block index of the worker.
+void* pool_worker(void* p) {
+    int block = (int)(size_t)p;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.stop && pool.generation == seen)
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        if (pool.stop)
+            break;
+        seen = pool.generation;
+        pool_task task = pool.task;
+        void* arg = pool.arg;
+        int n = pool.n;
+        pthread_mutex_unlock(&pool.lock);
+        pool_block(task, arg, block, n);
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.pending == 0)
+            pthread_cond_signal(&pool.finished);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return 0;
+}
+
+#endif
+
+// Start the pool with 'threads' threads (0 picks the amount of online processors).
+void pool_start(int threads) {
+#ifdef SIMPLEX_THREADS
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads < 1)
+        threads = 1;
+    pthread_mutex_init(&pool.lock, 0);
+    pthread_cond_init(&pool.wake, 0);
+    pthread_cond_init(&pool.finished, 0);
+    pool.stop = 0;
+    pool.busy = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&pool.workers[i], 0, pool_worker, (void*)(size_t)i) != 0) {
+            threads = i; // Continue with the threads we have
+            break;
         }
     }
-    return leave;
+    pool.threads = threads;
+#else
+    pool.threads = 1;
+#endif
 }
 
-dictionary pivot(dictionary d, int enter, int leaving) {
+// Stop and join all worker threads.
+void pool_stop() {
+#ifdef SIMPLEX_THREADS
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 1; i < pool.threads; i++)
+        pthread_join(pool.workers[i], 0);
+    pthread_cond_destroy(&pool.wake);
+    pthread_cond_destroy(&pool.finished);
+    pthread_mutex_destroy(&pool.lock);
+#endif
+    pool.threads = 1;
+}
 
-    // Grab pivot
-    double pivot = d.dic.data[leaving].data[enter];
+// Run 'task' over 'n' rows, split over the pool if the tableau has at least 'cells' cells.
+// Returns the amount of blocks the rows were split into.
+int pool_run(pool_task task, void* arg, int n, long cells) {
+#ifdef SIMPLEX_THREADS
+    if (pool.threads > 1 && !pool.busy && cells >= pool.threshold && n >= pool.threads) {
+        pthread_mutex_lock(&pool.lock);
+        pool.busy = 1;
+        pool.task = task;
+        pool.arg = arg;
+        pool.n = n;
+        pool.pending = pool.threads - 1;
+        pool.generation++;
+        pthread_cond_broadcast(&pool.wake);
+        pthread_mutex_unlock(&pool.lock);
+        pool_block(task, arg, 0, n);
+        pthread_mutex_lock(&pool.lock);
+        while (pool.pending > 0)
+            pthread_cond_wait(&pool.finished, &pool.lock);
+        pool.busy = 0;
+        pthread_mutex_unlock(&pool.lock);
+        return pool.threads;
+    }
+#endif
+    task(arg, 0, 0, n);
+    return 1;
+}
 
-    // Correct Remaining rows
-    for (int i = 0; i < d.dic.rows; i++)
-        if (i != leaving) {
-            double ratio = -(d.dic.data[i].data[enter] / pivot);
-            for (int j = 0; j < d.dic.columns; j++) {
-                if (j == enter)
-                    d.dic.data[i].data[j] = -ratio;
-                else
-                    d.dic.data[i].data[j] += ratio * d.dic.data[leaving].data[j];
-            }
-        }
+// A pricing rule picks the entering column of the dictionary among the columns with a positive objective coefficient.
+// Rules with weights keep one weight per column in dictionary.weights, set up by 'init' on first use and
+// updated by 'update' in pivot before the rows change.
+typedef struct {
+    const char* name; // The name used on the command line
+    void (*init)(dictionary* d); // Set up the weights (0 for rules without weights)
+    int (*enter)(dictionary* d); // Get the entering column, -1 if the dictionary is optimal
+    void (*update)(dictionary* d, int enter, int leaving); // Update the weights for a pivot (0 for rules without weights)
+} pricing_rule;
+
+// Dantzig's rule: the largest objective coefficient, the first one on ties.
+double dantzig_score(void* ctx, int j) {
+    double v = mat_row(&((dictionary*)ctx)->dic, 0)[j];
+    return v > SIMPLEX_EPS && !is_fixed((dictionary*)ctx, j) ? v : 0;
+}
 
-    // Correct leaving row
-    for (int i = 0; i < d.dic.data[leaving].size; i++)
-        if (i == enter)
-            d.dic.data[leaving].data[i] = 1.0 / pivot;
-        else
-            d.dic.data[leaving].data[i] /= -pivot;
+int dantzig_enter(dictionary* d) {
+    return price_scan(&d->price, 1, d->dic.columns - 1, dantzig_score, d);
+}
 
-    // Swap out vars
-    unsigned char tmp = d.vars[enter - 1];
-    d.vars[enter-1] = d.vars[d.varc + leaving - 1];
-    d.vars[d.varc + leaving - 1] = tmp;
+// Weighted rules: the largest squared objective coefficient relative to the column weight.
+double weighted_score(void* ctx, int j) {
+    dictionary* d = (dictionary*)ctx;
+    double v = mat_row(&d->dic, 0)[j];
+    return v > SIMPLEX_EPS && !is_fixed(d, j) ? v * v / d->weights[j] : 0;
+}
 
-    // Return updated dictionary
-    return d;
+int weighted_enter(dictionary* d) {
+    return price_scan(&d->price, 1, d->dic.columns - 1, weighted_score, d);
+}
 
+// Allocate the weights of a dictionary, the second half is scratch space for updates.
+double* alloc_weights(dictionary* d) {
+    dic_release(d, d->weights);
+    d->weights = (double*)context_alloc(d->ctx, sizeof(double) * 2 * d->dic.columns);
+    return d->weights;
 }
 
-// Performs phase two of the simplex method.
-dictionary phase_two(dictionary dic);
+// Devex reference weights, with the current nonbasic variables as reference framework.
+void devex_reset(dictionary* d) {
+    for (int j = 0; j < d->dic.columns; j++)
+        d->weights[j] = 1.0;
+}
 
-// Performs phase one of the simplex method which brings negative bounds into a feasible dictionary.
-dictionary phase_one(dictionary initial) {
+void devex_init(dictionary* d) {
+    alloc_weights(d);
+    devex_reset(d);
+}
 
-    // Check if there's reason for doing phase one
-    int skip = 1;
-    for (int i = 1; i < initial.dic.rows; i++)
-        if (initial.dic.data[i].data[0] < 0)
-            skip = 0;
+// Devex update (Forrest and Goldfarb) from the leaving row only.
+// The framework is reset (in place) once the weights have grown too far to be a good estimate.
+void devex_update(dictionary* d, int enter, int leaving) {
+    double* prow = mat_row(&d->dic, leaving);
+    double* w = d->weights;
+    double wq = w[enter];
+    double pivot = prow[enter];
+    for (int j = 1; j < d->dic.columns; j++) {
+        if (j == enter || prow[j] == 0)
+            continue;
+        double t = prow[j] / pivot;
+        if (t * t * wq > w[j])
+            w[j] = t * t * wq;
+    }
+    w[enter] = fmax(wq / (pivot * pivot), 1.0);
+    if (w[enter] > 1e6)
+        devex_reset(d);
+}
 
-    // Bail if phase one is not required
-    if (skip) {
-        printf("Skipping Phase One\n");
-        return initial;
+// Exact steepest edge weights: one plus the squared norm of every column over the constraint rows.
+void steepest_init(dictionary* d) {
+    double* w = alloc_weights(d);
+    for (int j = 0; j < d->dic.columns; j++)
+        w[j] = 1.0;
+    for (int i = 1; i < d->dic.rows; i++) {
+        double* row = mat_row(&d->dic, i);
+        for (int j = 1; j < d->dic.columns; j++)
+            w[j] += row[j] * row[j];
     }
+}
 
-    // Log we're solving the auxiliary problem
-    printf("--- Solving Auxiliary Problem ---\n");
+// Steepest edge update (Goldfarb and Reid). With t = prow[j] / prow[enter] and
+// dot[j] the product of the entering column with column j, the new weights are
+// w[j] - 2 t dot[j] + t^2 w[enter] and w[enter] / prow[enter]^2 for the leaving variable.
+void steepest_update(dictionary* d, int enter, int leaving) {
+    double* prow = mat_row(&d->dic, leaving);
+    double* w = d->weights;
+    double* dot = w + d->dic.columns;
+    int columns = d->dic.columns;
+    memset(dot, 0, sizeof(double) * columns);
+    for (int i = 1; i < d->dic.rows; i++) {
+        double* row = mat_row(&d->dic, i);
+        double f = row[enter];
+        if (f == 0)
+            continue;
+        for (int j = 1; j < columns; j++)
+            dot[j] += f * row[j];
+    }
+    double wq = w[enter];
+    double pivot = prow[enter];
+    for (int j = 1; j < columns; j++) {
+        if (j == enter || prow[j] == 0)
+            continue;
+        double t = prow[j] / pivot;
+        w[j] = fmax(w[j] - 2 * t * dot[j] + t * t * wq, 1.0 + t * t); // Guard against cancellation
+    }
+    w[enter] = fmax(wq / (pivot * pivot), 1.0);
+}
 
-    // Create new coefficient matrix
-    vector c = vec(initial.varc + 1);
-    c.data[initial.varc] = -1;
-    memset(c.data, 0, sizeof(double) * initial.varc);
+// The available pricing rules
+const pricing_rule pricing_rules[] = {
+    { "dantzig", 0, dantzig_enter, 0 },
+    { "devex", devex_init, weighted_enter, devex_update },
+    { "steepest", steepest_init, weighted_enter, steepest_update },
+};
+
+// The pricing rule used by find_pivot and pivot (selected by select_pricing)
+const pricing_rule* pricing = &pricing_rules[0];
+
+// Select the pricing rule by name ("dantzig", "devex" or "steepest").
+// Returns 0 if the rule is unknown.
+int select_pricing(const char* name) {
+    for (int i = 0; i < (int)(sizeof(pricing_rules) / sizeof(pricing_rules[0])); i++) {
+        if (strcmp(name, pricing_rules[i].name) == 0) {
+            pricing = &pricing_rules[i];
+            return 1;
+        }
+    }
+    return 0;
+}
 
-    // Copy bounds matrix
-    vector b = vec(initial.dic.rows - 1);
-    for (int i = 1; i < initial.dic.rows; i++)
-        b.data[i - 1] = initial.dic.data[i].data[0];
+// Ratio test state shared by the blocks of find_pivot
+typedef struct {
+    dictionary* d; // The dictionary
+    int enter; // The entering column
+    double relax; // Bound violation allowed to the basic variables
+    double bound; // The step bound of the first Harris pass (used by harris_rows)
+    double ratio[MAX_THREADS]; // The smallest ratio found by each block
+    double pivot[MAX_THREADS]; // The size of the pivot of each block (harris_rows only)
+    int leave[MAX_THREADS]; // The row of the smallest ratio of each block (-1 if none)
+} ratio_task;
+
+// Ratio test over the constraint rows [begin + 1, end + 1).
+void ratio_rows(void* arg, int block, int begin, int end) {
+    ratio_task* t = (ratio_task*)arg;
+    int leave = -1;
+    double minRatio = INFINITY;
+    for (int i = begin + 1; i < end + 1; i++){
+        double ratio = row_ratio(t->d, i, t->enter, t->relax);
+        if (ratio < minRatio) {
+            minRatio = ratio;
+            leave = i;
+        }
+    }
+    t->ratio[block] = minRatio;
+    t->leave[block] = leave;
+}
 
-    // Create new constraint matrix
-    matrix a = mat(initial.dic.rows - 1, initial.dic.columns);
-    for (int i = 1; i < initial.dic.rows; i++) {
-        for (int j = 1; j < initial.dic.columns; j++) {
-            a.data[i - 1].data[j - 1] = -initial.dic.data[i].data[j];
+// Second Harris pass over the constraint rows [begin + 1, end + 1): the largest pivot among the rows
+// whose exact ratio is within the bound of the first pass.
+void harris_rows(void* arg, int block, int begin, int end) {
+    ratio_task* t = (ratio_task*)arg;
+    int leave = -1;
+    double best = 0, ratio = INFINITY;
+    for (int i = begin + 1; i < end + 1; i++){
+        double r = row_ratio(t->d, i, t->enter, 0);
+        double p = fabs(mat_row(&t->d->dic, i)[t->enter]);
+        if (r <= t->bound && p > best) {
+            best = p;
+            ratio = r;
+            leave = i;
         }
-        a.data[i - 1].data[initial.varc] = -1;
     }
+    t->pivot[block] = best;
+    t->ratio[block] = ratio;
+    t->leave[block] = leave;
+}
 
-    // Construct the auxiliary problem dictionary
-    dictionary aux = create_dic(&c, &b, &a);
-    aux.vars[c.size - 1] = 0;
+// Bland's rule: the column of the smallest variable with a positive objective coefficient.
+int bland_enter(dictionary* d) {
+    double* obj = mat_row(&d->dic, 0);
+    int enter = -1;
+    for (int j = 1; j < d->dic.columns; j++)
+        if (obj[j] > SIMPLEX_EPS && !is_fixed(d, j) && (enter == -1 || d->vars[j - 1] < d->vars[enter - 1]))
+            enter = j;
+    return enter;
+}
 
-    // Debug aux
-    printf("Auxiliary dictionary:\n");
-    print_dictionary(&aux);
+// Find the entering column and the leaving row of the next pivot, the leaving row is 0 if the entering
+// variable reaches its own upper bound first (a bound flip instead of a pivot).
+int find_pivot(dictionary* d, int* enter, int* leave) {
+
+    // Free nonbasic variables can enter in either direction: those that improve the objective by
+    // decreasing are turned around first
+    matrix* dic = &d->dic;
+    if (d->forms) {
+        double* obj = mat_row(dic, 0);
+        for (int j = 1; j < dic->columns; j++)
+            if (obj[j] < -SIMPLEX_EPS && d->forms[d->vars[j - 1]].free)
+                flip_column(d, j);
+    }
 
-    // Pick enter and leave
-    int enter = aux.varc;
-    int leave = most_infeasible(&aux.dic, enter);
+    // Find the entering column with the pricing rule
+    STATS_CLOCK(start);
+    if (d->bland) {
+        *enter = bland_enter(d);
+    } else {
+        if (pricing->init && !d->weights)
+            pricing->init(d);
+        *enter = pricing->enter(d);
+    }
+    STATS_TIME(pricing, start);
+
+    // Return if none is found
+    if (*enter == -1)
+        return SIMPLEX_STATE_SUCCESS; // No positive coefficent, we're done
+    STATS_CLOCK(ratio);
+
+    // Find smallest constraint (leaving), blocks are merged in order so ties go to the first row.
+    // The Harris ratio test first finds the step with the bounds relaxed by the primal tolerance
+    // (Bland's rule needs the exact minimum to guarantee termination).
+    int harris = tolerance_opts.harris && !d->bland;
+    long work = (long)dic->rows * dic->columns;
+    ratio_task t;
+    t.d = d;
+    t.enter = *enter;
+    t.relax = harris ? tolerance_opts.primal : 0;
+    int blocks = pool_run(ratio_rows, &t, dic->rows - 1, work);
+    *leave = -1;
+    double minRatio = INFINITY;
+    for (int b = 0; b < blocks; b++) {
+        if (t.leave[b] != -1 && t.ratio[b] < minRatio) {
+            minRatio = t.ratio[b];
+            *leave = t.leave[b];
+        }
+    }
+
+    // Then takes the largest pivot among the rows that block within that step
+    if (harris && *leave != -1) {
+        t.bound = minRatio;
+        blocks = pool_run(harris_rows, &t, dic->rows - 1, work);
+        double best = 0;
+        for (int b = 0; b < blocks; b++) {
+            if (t.leave[b] != -1 && t.pivot[b] > best) {
+                best = t.pivot[b];
+                minRatio = t.ratio[b];
+                *leave = t.leave[b];
+            }
+        }
+    }
+
+    // Bland's rule breaks ties by the smallest variable
+    if (d->bland && *leave != -1) {
+        for (int i = 1; i < dic->rows; i++) {
+            if (row_ratio(d, i, *enter, 0) <= minRatio && d->vars[d->varc + i - 1] < d->vars[d->varc + *leave - 1])
+                *leave = i;
+        }
+    }
+
+    // The entering variable can reach its own upper bound first
+    double upper = var_upper(d, d->vars[*enter - 1]);
+    if (upper < INFINITY && upper <= minRatio)
+        *leave = 0;
+    STATS_TIME(ratio, ratio);
+
+    // Verify
+    if (*leave == -1)
+        return SIMPLEX_STATE_UNBOUNDED; // Unbounded
+
+    // Return 1 ==> Pivot found
+    return SIMPLEX_STATE_FEASIBLE;
+
+}
+
+// Find the row of the basic variable that needs the largest increase of the entering column 'enter' to
+// become feasible, rows with an entry below the pivot tolerance are skipped.
+int most_infeasible(dictionary* d, int enter) {
+    matrix* dic = &d->dic;
+    int leave = 1;
+    double maxRatio = -INFINITY;
+    for (int i = 1; i < dic->rows; i++){
+        if (is_free(d, d->vars[d->varc + i - 1]))
+            continue; // Free variables are never infeasible
+        double* row = mat_row(dic, i);
+        double den = row[enter];
+        if (fabs(den) < tolerance_opts.pivot)
+            continue; // Too small to pivot on
+        double ratio = row[0] / -den;
+        if (ratio > maxRatio && ratio >= -tolerance_opts.primal) {
+            maxRatio = ratio;
+            leave = i;
+        }
+    }
+    return leave;
+}
+
+// Row update kernel used by pivot, computes row[j] += f * prow[j] for 0 <= j < n.
+typedef void (*row_kernel)(double* row, const double* prow, double f, int n);
+
+// Reference row update, also used to verify the vectorized kernels.
+void row_update_scalar(double* row, const double* prow, double f, int n) {
+    for (int j = 0; j < n; j++)
+        row[j] += f * prow[j];
+}
+
+#ifdef SIMPLEX_X86_KERNELS
+
+// Row update using SSE2 (two doubles per instruction).
+__attribute__((target("sse2")))
+void row_update_sse2(double* row, const double* prow, double f, int n) {
+    __m128d vf = _mm_set1_pd(f);
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m128d r0 = _mm_add_pd(_mm_loadu_pd(row + j), _mm_mul_pd(vf, _mm_loadu_pd(prow + j)));
+        __m128d r1 = _mm_add_pd(_mm_loadu_pd(row + j + 2), _mm_mul_pd(vf, _mm_loadu_pd(prow + j + 2)));
+        _mm_storeu_pd(row + j, r0);
+        _mm_storeu_pd(row + j + 2, r1);
+    }
+    for (; j < n; j++)
+        row[j] += f * prow[j];
+}
+
+// Row update using AVX2 and FMA (four doubles per instruction, one cache line per iteration).
+__attribute__((target("avx2,fma")))
+void row_update_avx2(double* row, const double* prow, double f, int n) {
+    __m256d vf = _mm256_set1_pd(f);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256d r0 = _mm256_fmadd_pd(vf, _mm256_loadu_pd(prow + j), _mm256_loadu_pd(row + j));
+        __m256d r1 = _mm256_fmadd_pd(vf, _mm256_loadu_pd(prow + j + 4), _mm256_loadu_pd(row + j + 4));
+        _mm256_storeu_pd(row + j, r0);
+        _mm256_storeu_pd(row + j + 4, r1);
+    }
+    for (; j < n; j++)
+        row[j] += f * prow[j];
+}
+
+#endif
+
+// The row update kernel used by pivot (selected by select_kernel)
+row_kernel row_update = row_update_scalar;
+
+// Select the row update kernel by name ("auto", "scalar", "sse2" or "avx2").
+// Returns 0 if the kernel is unknown or not supported by this CPU.
+int select_kernel(const char* name) {
+    int isAuto = strcmp(name, "auto") == 0;
+#ifdef SIMPLEX_X86_KERNELS
+    __builtin_cpu_init();
+    if ((isAuto || strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        row_update = row_update_avx2;
+        return 1;
+    }
+    if ((isAuto || strcmp(name, "sse2") == 0) && __builtin_cpu_supports("sse2")) {
+        row_update = row_update_sse2;
+        return 1;
+    }
+#endif
+    if (isAuto || strcmp(name, "scalar") == 0) {
+        row_update = row_update_scalar;
+        return 1;
+    }
+    return 0;
+}
+
+// Row update state shared by the blocks of pivot
+typedef struct {
+    matrix* dic; // The dictionary matrix
+    double* prow; // The leaving row, already solved for the entering variable
+    int enter; // The entering column
+    int leaving; // The leaving row
+} pivot_task;
+
+// Substitute the leaving row into the rows [begin, end).
+// The entering column is fixed up afterwards so the kernel has no branch.
+void pivot_rows(void* arg, int block, int begin, int end) {
+    pivot_task* t = (pivot_task*)arg;
+    (void)block;
+    for (int i = begin; i < end; i++) {
+        if (i == t->leaving)
+            continue;
+        double* row = mat_row(t->dic, i);
+        double f = row[t->enter];
+        if (f == 0)
+            continue; // Row does not depend on the entering variable
+        row_update(row, t->prow, f, t->dic->columns);
+        row[t->enter] = f * t->prow[t->enter];
+    }
+}
+
+dictionary pivot(dictionary d, int enter, int leaving) {
+
+    // Grab pivot
+    STATS_CLOCK(start);
+    double* prow = mat_row(&d.dic, leaving);
+    double pivot = prow[enter];
+
+    // Update the pricing weights from the dictionary before the pivot
+    if (pricing->update && d.weights)
+        pricing->update(&d, enter, leaving);
+
+    // Correct leaving row (solve it for the entering variable)
+    for (int i = 0; i < d.dic.columns; i++)
+        prow[i] /= -pivot;
+    prow[enter] = 1.0 / pivot;
+
+    // The perturbation is carried along like the bound column
+    if (d.perturb) {
+        double p = d.perturb[leaving] / -pivot;
+        for (int i = 0; i < d.dic.rows; i++)
+            if (i != leaving)
+                d.perturb[i] += mat_row(&d.dic, i)[enter] * p;
+        d.perturb[leaving] = p;
+    }
+
+    // Correct Remaining rows
+    pivot_task t = { &d.dic, prow, enter, leaving };
+    pool_run(pivot_rows, &t, d.dic.rows, (long)d.dic.rows * d.dic.columns);
+
+    // Swap out vars
+    int tmp = d.vars[enter - 1];
+    d.vars[enter-1] = d.vars[d.varc + leaving - 1];
+    d.vars[d.varc + leaving - 1] = tmp;
+    d.iterations++;
+    STATS_TIME(update, start);
+
+    // Return updated dictionary
+    return d;
+
+}
+
+// Performs phase two of the simplex method.
+dictionary phase_two(dictionary dic);
+
+// Set the objective row of a dictionary to 'c' (one coefficient per decision variable) in terms of its
+// nonbasic variables: the coefficients times the expression of every decision variable in its form.
+void set_objective(dictionary* d, vector* c) {
+    int n = d->varc, columns = d->dic.columns;
+    double* obj = mat_row(&d->dic, 0);
+    memset(obj, 0, sizeof(double) * columns);
+    for (int k = 0; k < c->size; k++) {
+        double f = c->data[k];
+        if (d->forms) {
+            obj[0] += f * d->forms[k + 1].offset;
+            f *= d->forms[k + 1].sign;
+        }
+        int j = index_of(d->vars, k + 1, 0, n);
+        if (j != -1) {
+            obj[j + 1] += f;
+        } else {
+            double* row = mat_row(&d->dic, index_of(d->vars, k + 1, n, n + d->dic.rows - 1) - n + 1);
+            row_update(obj, row, f, columns);
+        }
+    }
+}
+
+// Performs phase one of the simplex method which brings negative bounds into a feasible dictionary.
+// The real objective is set up again for phase two.
+dictionary phase_one(dictionary initial, vector* objective) {
+
+    // Check if there's reason for doing phase one, basic variables above their upper bound are flipped
+    // so that they are below zero
+    int skip = 1;
+    for (int i = 1; i < initial.dic.rows; i++) {
+        if (infeasibility(&initial, i) > 0) {
+            if (mat_row(&initial.dic, i)[0] > 0)
+                flip_row(&initial, i);
+            skip = 0;
+        }
+    }
+
+    // Bail if phase one is not required
+    writer* out = initial.out;
+    if (skip) {
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, "Skipping Phase One\n");
+        return initial;
+    }
+
+    // Log we're solving the auxiliary problem
+    if (out->level >= VERBOSITY_NORMAL)
+        wr_printf(out, "--- Solving Auxiliary Problem ---\n");
+
+    // Construct the auxiliary problem dictionary: the initial rows with a last column for x0, which has a
+    // coefficient of one in every row and the objective -x0. x0 is variable 0 and the slack variables
+    // move up by one (eliminate_column moves them back).
+    simplex_context* ctx = initial.ctx;
+    int n = initial.varc, rows = initial.dic.rows - 1, vars = n + rows, last = 0;
+    dictionary aux;
+    aux.varc = n + 1;
+    aux.ctx = ctx;
+    aux.dic = mat_in(ctx, rows + 1, n + 2);
+    STATS_PEAK(sizeof(double) * ((size_t)aux.dic.stride * aux.dic.rows + (size_t)initial.dic.stride * initial.dic.rows));
+    aux.state = SIMPLEX_STATE_FEASIBLE;
+    aux.out = out;
+    aux.weights = 0;
+    aux.iterations = 0;
+    price_init(&aux.price, ctx);
+    aux.bland = 0;
+    aux.perturb = 0;
+    aux.fixed = 0;
+    aux.forms = 0;
+    aux.post = 0;
+    aux.scale = 0;
+    double* obj = mat_row(&aux.dic, 0);
+    memset(obj, 0, sizeof(double) * (n + 1));
+    obj[n + 1] = -1;
+    for (int i = 1; i <= rows; i++) {
+        double* row = mat_row(&aux.dic, i);
+        memcpy(row, mat_row(&initial.dic, i), sizeof(double) * (n + 1));
+        row[n + 1] = 1;
+    }
+    aux.vars = (int*)context_alloc(ctx, sizeof(int) * ((size_t)vars + 1));
+    for (int i = 0; i < vars; i++) {
+        aux.vars[i < n ? i : i + 1] = initial.vars[i] + (initial.vars[i] > n);
+        last = initial.vars[i] > last ? initial.vars[i] : last;
+    }
+    aux.vars[n] = 0;
+    if (initial.fixed) {
+        aux.fixed = alloc_fixed(&aux, (size_t)last + 2);
+        for (int v = 1; v <= last; v++)
+            aux.fixed[v + (v > n)] = initial.fixed[v];
+    }
+    if (initial.forms) {
+        var_form none = { INFINITY, 0, 1, 0 };
+        aux.forms = (var_form*)context_alloc(ctx, sizeof(var_form) * ((size_t)last + 2));
+        aux.forms[0] = none;
+        for (int v = 1; v <= last; v++)
+            aux.forms[v + (v > n)] = initial.forms[v];
+    }
+
+    // Debug aux
+    if (out->level >= VERBOSITY_TRACE) {
+        wr_printf(out, "Auxiliary dictionary:\n");
+        print_dictionary(&aux);
+    }
+
+    // Pick enter and leave
+    int enter = aux.varc;
+    int leave = most_infeasible(&aux, enter);
 
     // Pivot towards feasibility
-    char e[5];
-    char l[5];
+    char e[VAR_NAME_SIZE];
+    char l[VAR_NAME_SIZE];
     get_var(&aux, e, aux.vars[enter - 1]);
     get_var(&aux, l, aux.vars[aux.varc + leave - 1]);
-    printf("%s entering and %s leaving:\n\n", e, l);
     aux = pivot(aux, enter, leave);
 
     // Print feasible dictionary
-    print_dictionary(&aux);
+    if (out->level >= VERBOSITY_TRACE) {
+        wr_printf(out, "%s entering and %s leaving:\n\n", e, l);
+        print_dictionary(&aux);
+    } else if (out->level >= VERBOSITY_NORMAL) {
+        wr_printf(out, "Iteration 0: %s entering, %s leaving, objective %.4f\n", e, l, mat_row(&aux.dic, 0)[0]);
+    }
 
     // Apply simplex on this dictionary
     aux = phase_two(aux);
-    if (aux.dic.data[0].data[0] < 0)
+    if (mat_row(&aux.dic, 0)[0] < -SIMPLEX_EPS)
         aux.state = SIMPLEX_STATE_INFEASIBLE;
-    if (aux.state == SIMPLEX_STATE_SUCCESS)
-        printf("--- Auxiliary Problem Solved ---\n");
-    else
+    if (aux.state != SIMPLEX_STATE_SUCCESS) {
+        freedic(&initial);
         return aux;
+    }
+    if (out->level >= VERBOSITY_NORMAL)
+        wr_printf(out, "--- Auxiliary Problem Solved ---\n");
+
+    // A degenerate x0 can still be basic (at zero), pivot it out on the largest entry of its row.
+    // If the row has no usable entry it is redundant and dropped.
+    int x0 = index_of(aux.vars, 0, aux.varc, aux.varc + aux.dic.rows - 1);
+    if (x0 != -1) {
+        int r = x0 - aux.varc + 1;
+        double* row = mat_row(&aux.dic, r);
+        int best = -1;
+        for (int j = 1; j < aux.dic.columns; j++)
+            if (fabs(row[j]) >= tolerance_opts.pivot && !is_fixed(&aux, j) && (best == -1 || fabs(row[j]) > fabs(row[best])))
+                best = j;
+        if (best != -1) {
+            aux = pivot(aux, best, r);
+        } else {
+            int end = aux.dic.rows - 1;
+            memcpy(row, mat_row(&aux.dic, end), sizeof(double) * aux.dic.columns);
+            aux.vars[x0] = aux.vars[aux.varc + end - 1];
+            aux.dic.rows--;
+        }
+    }
 
     // Eliminate column
     eliminate_column(&aux, index_of(aux.vars, 0, 0, aux.varc));
-
-    // Reintroduce objective function and remove x0
-    vector obj = vec(initial.varc + 1);
-    for (int i = 0; i < initial.varc; i++) {
-
-        // Find the value in 
-        int k = -1;
-        for (int j = 1; j < aux.dic.rows; j++) {
-            if (aux.vars[j - 1 + aux.varc] == initial.vars[i]) {
-                k = j;
-                break;
-            }
-        }
-        double scalar = initial.dic.data[0].data[i + 1];
-        vector v;
-        if (k != -1) {
-            vec_copy(&aux.dic.data[k], &v);
-        } else {
-            aux.state = SIMPLEX_STATE_INFEASIBLE; // x_0 != 0 and thus no feasible solution to the auxiliary problem
-            // This will require a check on x_0 value in basic variables section but too lazy to do that now
-            return aux;
-        }
-        // Multiply and add to updated objective function
-        vec_mul(&v, scalar);
-        vec_add(&obj, &v);
+    dic_release(&aux, aux.fixed);
+    aux.fixed = initial.fixed;
+    initial.fixed = 0;
+    if (aux.forms) {
+        for (int v = 1; v <= last; v++)
+            initial.forms[v] = aux.forms[v + (v > n)];
+        dic_release(&aux, aux.forms);
+        aux.forms = initial.forms;
+        initial.forms = 0;
     }
+    freedic(&initial);
+
+    // Reintroduce objective function
+    set_objective(&aux, objective);
 
-    // free current
-    freevec(&aux.dic.data[0]);
-    aux.dic.data[0] = obj;
+    // The columns changed, the pricing weights and candidates are set up again for the main problem
+    dic_release(&aux, aux.weights);
+    aux.weights = 0;
+    aux.price.count = 0;
     
     // Log main problem
-    printf("---   Solving Main Problem   ---\n\n");
-    print_dictionary(&aux);
-    printf("\n");
+    if (out->level >= VERBOSITY_NORMAL)
+        wr_printf(out, "---   Solving Main Problem   ---\n\n");
+    if (out->level >= VERBOSITY_TRACE) {
+        print_dictionary(&aux);
+        wr_printf(out, "\n");
+    }
 
     // Set state
     aux.state = SIMPLEX_STATE_FEASIBLE;
@@ -502,282 +1803,3939 @@ dictionary phase_one(dictionary initial) {
 }
 
 // Performs phase two of the simplex method.
+// Perturb the bounds of all constraint rows by a small positive amount, so ties in the ratio test
+// (and with them degenerate pivots) become unlikely. The amounts are fixed per row for reproducible runs.
+void perturb_bounds(dictionary* d) {
+    d->perturb = (double*)context_alloc(d->ctx, sizeof(double) * d->dic.rows);
+    d->perturb[0] = 0;
+    for (int i = 1; i < d->dic.rows; i++) {
+        double* row = mat_row(&d->dic, i);
+        double u = fmod(i * 0.6180339887498949, 1.0); // Spread the amounts over [1, 2) times the scale
+        d->perturb[i] = degeneracy_opts.perturb * (1.0 + u) * (1.0 + fabs(row[0]));
+        row[0] += d->perturb[i];
+    }
+}
+
+// Performs the dual simplex method on a dictionary whose objective row is optimal (no positive
+// coefficient) but with basic variables below zero. The most negative basic variable leaves and the
+// dual ratio test picks the entering column that keeps the objective row optimal (the largest entry
+// on ties). Degenerate stalls fall back to Bland's rule like phase_two. Returns the new state.
+int dual_simplex(dictionary* d) {
+
+    char ev[VAR_NAME_SIZE];
+    char lv[VAR_NAME_SIZE];
+    writer* out = d->out;
+    long limit = iteration_limit(d->dic.rows, d->dic.columns);
+    int stalls = 0, bland = 0;
+    for (long k = 0; k < limit; k++) {
+
+        // Leaving: the most infeasible basic variable (the smallest one under Bland's rule), one above its
+        // upper bound is flipped so that it is below zero
+        STATS_CLOCK(start);
+        int r = -1;
+        double worst = SIMPLEX_EPS;
+        for (int i = 1; i < d->dic.rows; i++) {
+            double v = infeasibility(d, i);
+            if (v > SIMPLEX_EPS && (r == -1 || (bland ? d->vars[d->varc + i - 1] < d->vars[d->varc + r - 1] : v > worst))) {
+                r = i;
+                worst = v;
+            }
+        }
+        STATS_TIME(pricing, start);
+        if (r == -1)
+            return SIMPLEX_STATE_SUCCESS;
+        if (mat_row(&d->dic, r)[0] > 0)
+            flip_row(d, r);
+        STATS_CLOCK(ratio);
+
+        // Entering: the column that keeps every objective coefficient nonpositive (free variables can
+        // enter in either direction)
+        double* obj = mat_row(&d->dic, 0);
+        double* row = mat_row(&d->dic, r);
+        int e = -1;
+        double minRatio = INFINITY;
+        for (int j = 1; j < d->dic.columns; j++) {
+            double a = d->forms && d->forms[d->vars[j - 1]].free ? fabs(row[j]) : row[j];
+            if (a >= tolerance_opts.pivot && !is_fixed(d, j)) {
+                double ratio = -obj[j] / a;
+                if (ratio < minRatio || (ratio == minRatio && (bland ? d->vars[j - 1] < d->vars[e - 1] : a > fabs(row[e])))) {
+                    minRatio = ratio;
+                    e = j;
+                }
+            }
+        }
+        STATS_TIME(ratio, ratio);
+        if (e == -1)
+            return SIMPLEX_STATE_INFEASIBLE; // The row can not reach zero
+        if (row[e] < 0)
+            flip_column(d, e);
+        STATS_ITERATION(minRatio <= SIMPLEX_EPS);
+
+        // Pivot and log
+        if (out->level >= VERBOSITY_NORMAL) {
+            get_var(d, ev, d->vars[e - 1]);
+            get_var(d, lv, d->vars[d->varc + r - 1]);
+        }
+        *d = pivot(*d, e, r);
+        if (out->level >= VERBOSITY_TRACE) {
+            wr_printf(out, "%s entering and %s leaving:\n\n", ev, lv);
+            print_dictionary(d);
+            wr_printf(out, "\n");
+            wr_flush(out);
+        } else if (out->level >= VERBOSITY_NORMAL) {
+            wr_printf(out, "Iteration %li: %s entering, %s leaving, objective %.4f\n", k + 1, ev, lv, mat_row(&d->dic, 0)[0]);
+        }
+
+        // Handle degeneracy (the objective did not change)
+        if (minRatio > SIMPLEX_EPS) {
+            stalls = 0;
+            bland = 0;
+        } else if (++stalls == degeneracy_opts.stall && !bland) {
+            bland = 1;
+            if (out->level >= VERBOSITY_NORMAL)
+                wr_printf(out, "Degenerate vertex, using Bland's rule\n");
+        }
+
+    }
+    return SIMPLEX_STATE_ITERATION_LIMIT;
+
+}
+
+// Remove the bound perturbation, restoring feasibility if the optimal basis depended on it.
+void remove_perturbation(dictionary* d) {
+    for (int i = 0; i < d->dic.rows; i++)
+        mat_row(&d->dic, i)[0] -= d->perturb[i];
+    dic_release(d, d->perturb);
+    d->perturb = 0;
+    if (d->state == SIMPLEX_STATE_SUCCESS) {
+        d->state = dual_simplex(d);
+        if (d->out->level >= VERBOSITY_NORMAL && d->state != SIMPLEX_STATE_SUCCESS)
+            wr_printf(d->out, "Bounds could not be restored after the perturbation\n");
+    }
+}
+
+// Performs phase two of the simplex method.
+// After 'stall' consecutive degenerate pivots the bounds are perturbed (if enabled) or Bland's rule
+// takes over until the objective improves again, and the phase stops at the iteration limit.
 dictionary phase_two(dictionary dic) {
 
     // Enter and leaving variable
     int e, l;
 
     // Make space for enter and leave names
-    char ev[5];
-    char lv[5];
+    char ev[VAR_NAME_SIZE];
+    char lv[VAR_NAME_SIZE];
 
     // While feasible
+    writer* out = dic.out;
+    int iteration = 0;
+    int stalls = 0;
+    long limit = iteration_limit(dic.dic.rows, dic.dic.columns);
     while (dic.state) {
         
         // Find pivot location
-        dic.state = find_pivot(&dic.dic, &e, &l);
+        dic.state = iteration < limit ? find_pivot(&dic, &e, &l) : SIMPLEX_STATE_ITERATION_LIMIT;
+        if (dic.perturb && dic.state != SIMPLEX_STATE_FEASIBLE)
+            remove_perturbation(&dic);
+        dic.bland = dic.state == SIMPLEX_STATE_FEASIBLE ? dic.bland : 0;
         switch (dic.state) {
         case SIMPLEX_STATE_SUCCESS:
-            printf("--- Simplex Terminating (Success) ---\n\n");
+            if (out->level >= VERBOSITY_NORMAL)
+                wr_printf(out, "--- Simplex Terminating (Success) ---\n\n");
             return dic;
         case SIMPLEX_STATE_INFEASIBLE:
-            printf("--- Simplex Terminating (Infeasible) ---\n\n");
+            if (out->level >= VERBOSITY_NORMAL)
+                wr_printf(out, "--- Simplex Terminating (Infeasible) ---\n\n");
             return dic;
         case SIMPLEX_STATE_UNBOUNDED:
-            printf("--- Simplex Terminating (Unbounded) ---\n\n");
+            if (out->level >= VERBOSITY_NORMAL)
+                wr_printf(out, "--- Simplex Terminating (Unbounded) ---\n\n");
+            return dic;
+        case SIMPLEX_STATE_ITERATION_LIMIT:
+            if (out->level >= VERBOSITY_NORMAL)
+                wr_printf(out, "--- Simplex Terminating (Iteration Limit) ---\n\n");
             return dic;
         default:
-            get_var(&dic, ev, dic.vars[e - 1]);
-            get_var(&dic, lv, dic.vars[dic.varc + l - 1]);
-            printf("%s entering and %s leaving:\n\n", ev, lv);
-            // pivot
-            dic = pivot(dic, e, l);
-            print_dictionary(&dic);
-            printf("\n");
-            
+            if (out->level >= VERBOSITY_NORMAL) {
+                get_var(&dic, ev, dic.vars[e - 1]);
+                get_var(&dic, lv, dic.vars[l > 0 ? dic.varc + l - 1 : e - 1]);
+            }
+            // A pivot is degenerate if the leaving variable is already at its bound
+            int degenerate = (l > 0 ? row_ratio(&dic, l, e, 0) : var_upper(&dic, dic.vars[e - 1])) <= SIMPLEX_EPS;
+            // pivot, or flip the entering variable to its upper bound. A basic variable leaving at its
+            // upper bound is flipped first, so that it leaves at zero.
+            STATS_ITERATION(degenerate);
+            if (l == 0) {
+                STATS_CLOCK(start);
+                flip_column(&dic, e);
+                dic.iterations++;
+                STATS_TIME(update, start);
+            } else {
+                if (mat_row(&dic.dic, l)[e] > 0)
+                    flip_row(&dic, l);
+                dic = pivot(dic, e, l);
+            }
+            iteration++;
+            if (out->level >= VERBOSITY_TRACE) {
+                if (l == 0)
+                    wr_printf(out, "%s moving to its other bound:\n\n", ev);
+                else
+                    wr_printf(out, "%s entering and %s leaving:\n\n", ev, lv);
+                print_dictionary(&dic);
+                wr_printf(out, "\n");
+                wr_flush(out);
+            } else if (out->level >= VERBOSITY_NORMAL) {
+                if (l == 0)
+                    wr_printf(out, "Iteration %i: %s moving to its other bound, objective %.4f\n", iteration, ev, mat_row(&dic.dic, 0)[0]);
+                else
+                    wr_printf(out, "Iteration %i: %s entering, %s leaving, objective %.4f\n", iteration, ev, lv, mat_row(&dic.dic, 0)[0]);
+            }
+            // Handle degeneracy
+            if (!degenerate) {
+                stalls = 0;
+                dic.bland = 0;
+            } else if (++stalls == degeneracy_opts.stall && !dic.bland) {
+                stalls = 0;
+                if (degeneracy_opts.perturb > 0 && !dic.perturb) {
+                    perturb_bounds(&dic);
+                    if (out->level >= VERBOSITY_NORMAL)
+                        wr_printf(out, "Degenerate vertex, perturbing the bounds\n");
+                } else {
+                    dic.bland = 1;
+                    if (out->level >= VERBOSITY_NORMAL)
+                        wr_printf(out, "Degenerate vertex, using Bland's rule\n");
+                }
+            }
             break;
         }
 
     }
 
+    return dic;
+
 }
 
-dictionary simplex(vector* c, vector* b, matrix* a) {
-    
-    // Prepare
-    dictionary dic = create_dic(c,b,a);
-    
-    // print inital
-    printf("Initial Dictionary:\n");
-    print_dictionary(&dic);
-    printf("\n");
+// Paths from an infeasible initial dictionary
+#define METHOD_AUTO 0 // Chosen per problem (see simplex)
+#define METHOD_PRIMAL 1 // The auxiliary problem of phase_one
+#define METHOD_DUAL 2 // The dual simplex method
 
-    // Do phase one
-    dic = phase_one(dic);
-    if (dic.state != SIMPLEX_STATE_FEASIBLE) {
-        return dic; // Return immediately
-    }
+// The path from an infeasible initial dictionary (set from the command line)
+int simplex_method = METHOD_AUTO;
 
-    // Do phase two and return result
-    return phase_two(dic);
-    
+// Log how a phase ended.
+void log_state(writer* out, int state) {
+    if (out->level < VERBOSITY_NORMAL)
+        return;
+    switch (state) {
+    case SIMPLEX_STATE_SUCCESS:
+        wr_printf(out, "--- Simplex Terminating (Success) ---\n\n");
+        break;
+    case SIMPLEX_STATE_INFEASIBLE:
+        wr_printf(out, "--- Simplex Terminating (Infeasible) ---\n\n");
+        break;
+    case SIMPLEX_STATE_UNBOUNDED:
+        wr_printf(out, "--- Simplex Terminating (Unbounded) ---\n\n");
+        break;
+    case SIMPLEX_STATE_ITERATION_LIMIT:
+        wr_printf(out, "--- Simplex Terminating (Iteration Limit) ---\n\n");
+        break;
+    }
 }
 
-// Print solution
-void print_solution(dictionary* dic) {
-
-    // Only print if success
-    if (dic->state == SIMPLEX_STATE_SUCCESS) {
-        printf("Maximum Value: %f\nVariables: ", dic->dic.data[0].data[0]);
-        for (int i = 1; i < dic->dic.rows; i++) {
-            char n[5];
-            get_var(dic, n, dic->vars[dic->varc - 1 + i]);
-            printf("%s = %.4f", n, dic->dic.data[i].data[0]);
-            if (i + 1 < dic->dic.rows)
-                printf(", ");
+// Pivot the basic slack variables of equality rows out of a dictionary, each on the largest entry of its
+// row outside the fixed columns. A row without such an entry is a combination of the other equalities:
+// it is dropped if its bound is zero, and makes the problem infeasible otherwise. The dictionary can be
+// infeasible afterwards. Returns the new state.
+int drive_out_equalities(dictionary* d) {
+
+    if (!d->fixed)
+        return d->state;
+    int pivots = 0, dropped = 0;
+    for (int r = 1; r < d->dic.rows; r++) {
+        if (!d->fixed[d->vars[d->varc + r - 1]])
+            continue;
+        double* row = mat_row(&d->dic, r);
+        int best = -1;
+        for (int j = 1; j < d->dic.columns; j++)
+            if (fabs(row[j]) >= tolerance_opts.pivot && !is_fixed(d, j) && (best == -1 || fabs(row[j]) > fabs(row[best])))
+                best = j;
+        if (best != -1) {
+            *d = pivot(*d, best, r);
+            pivots++;
+        } else if (fabs(row[0]) > SIMPLEX_EPS) {
+            return SIMPLEX_STATE_INFEASIBLE;
+        } else {
+            int last = d->dic.rows - 1;
+            memcpy(row, mat_row(&d->dic, last), sizeof(double) * d->dic.columns);
+            d->vars[d->varc + r - 1] = d->vars[d->varc + last - 1];
+            d->dic.rows--;
+            dropped++;
+            r--;
         }
-    } else if (dic->state == SIMPLEX_STATE_INFEASIBLE) {
-        printf("Problem is infeasible and has no solution");
-    } else if (dic->state == SIMPLEX_STATE_UNBOUNDED) {
-        printf("Problem is unbounded and thus has no optimal solution");
     }
-    printf("\n\n");
 
-}
+    writer* out = d->out;
+    if (out->level >= VERBOSITY_NORMAL)
+        wr_printf(out, "Equality rows: %i slack variables pivoted out, %i redundant rows dropped\n", pivots, dropped);
+    if (out->level >= VERBOSITY_TRACE) {
+        print_dictionary(d);
+        wr_printf(out, "\n");
+    }
+    return d->state;
 
-typedef struct {
-    int vars;
-    char max;
-    vector c; // Coefficients
-    vector b; // Bounds
-    matrix a; // Constraints
-} linprog;
+}
 
-// Read a problem from file
-linprog read_problem(const char* pFilePath) {
+// Solve a problem with the tableau engine.
+// A feasible initial dictionary goes straight to phase two. Otherwise either the auxiliary problem of
+// phase_one finds a feasible dictionary, or the dual simplex method runs on the initial dictionary:
+// directly if its objective row is already optimal, and else on shifted costs (which the initial
+// dictionary is optimal for) to find a feasible dictionary, after which the real objective is put back
+// for phase two. The automatic choice takes the dual path when the objective row is optimal or at most
+// half of the rows are infeasible; with more, the dual needs more pivots than the auxiliary problem.
+// The dictionaries are allocated from 'ctx' (the heap if 0), so the pivots themselves never allocate.
+dictionary simplex(vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb, simplex_context* ctx, writer* out) {
     
-    // Define the program to be read
-    linprog prog;
-    prog.max = -1;
+    // Prepare
+    dictionary dic = create_dic(c, b, a, sense, vb, ctx);
+    dic.out = out;
     
-    // Open file
-    FILE* pFile = fopen(pFilePath, "r");
-
-    // Read over 'variables '
-    fseek(pFile, 10, SEEK_SET);
-    if (fscanf(pFile, "%d", &prog.vars) <= 0){
-        fprintf(stderr, "Problem variable count expected but none found.\n");
-        return prog;
+    // print inital
+    if (out->level >= VERBOSITY_TRACE) {
+        wr_printf(out, "Initial Dictionary:\n");
+        print_dictionary(&dic);
+        wr_printf(out, "\n");
     }
 
-    // Read minmax mode
-    char minmax[4];
-    if (fscanf(pFile, "%3s", minmax) <= 0) {
-        fprintf(stderr, "Objective goal expected but was not valid. (allowed: min, max)\n");
-        return prog;
+    // Equality rows
+    dic.state = drive_out_equalities(&dic);
+    if (dic.state == SIMPLEX_STATE_INFEASIBLE) {
+        log_state(out, dic.state);
+        return dic;
     }
 
-    // Read coefficients
-    prog.c = vec(prog.vars);
-    for (int i = 0; i < prog.vars; i++){
-        float f;
-        if (!fscanf(pFile, "%f", &f)) {
-            printf("Failed to read coefficient %i.\n", i + 1);
-            return prog;
+    // Pick the path
+    int infeasible = 0, optimal = 1, rows = dic.dic.rows - 1;
+    double* obj = mat_row(&dic.dic, 0);
+    for (int i = 1; i <= rows; i++)
+        infeasible += infeasibility(&dic, i) > 0;
+    for (int j = 1; j < dic.dic.columns; j++)
+        optimal &= (is_free(&dic, dic.vars[j - 1]) ? fabs(obj[j]) <= SIMPLEX_EPS : obj[j] <= 0) || is_fixed(&dic, j);
+    int dual = simplex_method == METHOD_DUAL || (simplex_method == METHOD_AUTO && (optimal || 2 * infeasible <= rows));
+    if (infeasible && dual) {
+
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, optimal ? "--- Dual Simplex ---\n" : "--- Dual Simplex (Zero Objective) ---\n");
+        if (!optimal) {
+            // Shifted costs: every coefficient made negative by a distinct amount, so that ties do not
+            // leave the dual degenerate (free variables need a zero coefficient)
+            for (int j = 1; j < dic.dic.columns; j++) {
+                double u = fmod(j * 0.6180339887498949, 1.0);
+                obj[j] = is_free(&dic, dic.vars[j - 1]) ? 0 : fmin(obj[j], 0) - (1.0 + u) * (1.0 + fabs(obj[j]));
+            }
+        }
+        dic.state = dual_simplex(&dic);
+        if (optimal || dic.state != SIMPLEX_STATE_SUCCESS) {
+            log_state(out, dic.state);
+            return dic;
         }
-        prog.c.data[i] = f;
-    }
 
-    // Read constraints
-    char cons[12];
-    if (fscanf(pFile, "%11s", cons) <= 0) {
-        fprintf(stderr, "'constraints' keyword expected following objective function definition.\n");
-        return prog;
+        // Feasible, continue with the real objective
+        set_objective(&dic, c);
+        dic.state = SIMPLEX_STATE_FEASIBLE;
+        STATS_PHASE(1);
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, "---   Solving Main Problem   ---\n\n");
+        if (out->level >= VERBOSITY_TRACE) {
+            print_dictionary(&dic);
+            wr_printf(out, "\n");
+        }
+        return phase_two(dic);
+
     }
 
-    // Read constraints
-    int constraints;
-    if (!fscanf(pFile, "%i", &constraints)){
-        printf("Failed to read constraint count.\n");
-        return prog;
+    // Do phase one
+    dic = phase_one(dic, c);
+    if (dic.state != SIMPLEX_STATE_FEASIBLE) {
+        return dic; // Return immediately
     }
 
-    // Bounds buffer
-    double* bufBounds = 0;
+    // Do phase two and return result
+    STATS_PHASE(1);
+    return phase_two(dic);
+    
+}
 
-    // Constraint buffer
-    vector* bufCons = 0;
+// A saved basis: the variables of a dictionary by position (nonbasic first, then one per constraint row)
+typedef struct {
+    int varc; // The amount of nonbasic variables
+    int rows; // The amount of basic variables
+    int* vars; // The variables, as in dictionary.vars
+} basis;
+
+// Save the basis of a solved dictionary.
+basis save_basis(dictionary* d) {
+    basis s;
+    s.varc = d->varc;
+    s.rows = d->dic.rows - 1;
+    s.vars = (int*)malloc(sizeof(int) * ((size_t)s.varc + s.rows));
+    memcpy(s.vars, d->vars, sizeof(int) * ((size_t)s.varc + s.rows));
+    return s;
+}
 
-    // Buffer size tracker
-    size_t addBuffCount = 0;
+void freebasis(basis* s) {
+    free(s->vars);
+}
 
-    // Write how many constraints we have
-    prog.a = mat(constraints, prog.vars);
-    prog.b = vec(constraints);
-    for (int i = 0; i < constraints; i++) {
+// Write a basis to a text file: "basis N M", then the N nonbasic and M basic variables. Returns 0 on failure.
+int write_basis(basis* s, const char* path) {
+    FILE* pFile = fopen(path, "w");
+    if (!pFile)
+        return 0;
+    fprintf(pFile, "basis %i %i\n", s->varc, s->rows);
+    for (int i = 0; i < s->varc + s->rows; i++)
+        fprintf(pFile, i + 1 == s->varc || i + 1 == s->varc + s->rows ? "%i\n" : "%i ", s->vars[i]);
+    int ok = !ferror(pFile);
+    return fclose(pFile) == 0 && ok;
+}
 
-        // Read constraints
-        float f;
-        for (int j = 0; j < prog.vars; j++) {
-            if (!fscanf(pFile, "%f", &f)) {
-                printf("Failed to read constraint coefficient a[%i,%i].\n", i,j);
-                return prog;
-            }
-            prog.a.data[i].data[j] = f;
+// Read a basis written by write_basis, the variable count is 0 on failure.
+basis read_basis(const char* path) {
+    basis s;
+    s.varc = 0;
+    s.rows = 0;
+    s.vars = 0;
+    FILE* pFile = fopen(path, "r");
+    if (!pFile)
+        return s;
+    int varc, rows;
+    if (fscanf(pFile, "basis %i %i", &varc, &rows) == 2 && varc > 0 && rows >= 0) {
+        s.vars = (int*)malloc(sizeof(int) * ((size_t)varc + rows));
+        int ok = 1;
+        for (int i = 0; i < varc + rows && ok; i++) {
+            int v;
+            ok = fscanf(pFile, "%i", &v) == 1 && v > 0 && v <= varc + rows;
+            s.vars[i] = v;
         }
-
-        // Read mode
-        char constrainType[3];
-        if (!fscanf(pFile, "%2s", constrainType)){
-            printf("Failed to read constraint type.\n");
-            return prog;
+        if (ok) {
+            s.varc = varc;
+            s.rows = rows;
         }
+    }
+    fclose(pFile);
+    return s;
+}
 
-        // Read bounds
-        if (!fscanf(pFile, "%f", &f)) {
-            printf("Failed to read constraint bound b[%i].\n", i);
-            return prog;
+// Pivot the basic variables of a saved basis into a dictionary, each replacing a variable the basis
+// does not have (on the largest entry). Returns the amount of pivots made.
+int install_basis(dictionary* d, basis* s) {
+    int vars = d->varc + d->dic.rows - 1;
+    char* want = (char*)calloc((size_t)vars + 1, 1);
+    for (int i = s->varc; i < s->varc + s->rows; i++)
+        want[s->vars[i]] = 1;
+    int pivots = 0;
+    for (int i = s->varc; i < s->varc + s->rows; i++) {
+        int j = index_of(d->vars, s->vars[i], 0, d->varc);
+        if (j == -1)
+            continue; // Already basic
+        int r = -1;
+        for (int k = 1; k < d->dic.rows; k++) {
+            double v = fabs(mat_row(&d->dic, k)[j + 1]);
+            if (!want[d->vars[d->varc + k - 1]] && v > SIMPLEX_EPS && (r == -1 || v > fabs(mat_row(&d->dic, r)[j + 1])))
+                r = k;
         }
+        if (r == -1)
+            continue; // The saved basis is singular for this problem, keep the current variable
+        *d = pivot(*d, j + 1, r);
+        pivots++;
+    }
+    free(want);
+    return pivots;
+}
 
-        // Set bound
-        prog.b.data[i] = f;
+// Continue solving from a dictionary in a warm start basis: the primal simplex method if the basis is
+// feasible, the dual simplex method if only the objective row is optimal, and a full solve otherwise.
+dictionary continue_from(dictionary dic, vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb) {
+
+    writer* out = dic.out;
+    int primal = 1, dual = 1;
+    for (int i = 1; i < dic.dic.rows; i++)
+        primal &= infeasibility(&dic, i) <= SIMPLEX_EPS;
+    for (int j = 1; j < dic.dic.columns; j++) {
+        double v = mat_row(&dic.dic, 0)[j];
+        dual &= (is_free(&dic, dic.vars[j - 1]) ? fabs(v) : v) <= SIMPLEX_EPS || is_fixed(&dic, j);
+    }
 
-        // Correct constraint
-        if (strcmp(constrainType, ">=") == 0) {
-            prog.b.data[i] *= -1;
-            vec_mul(&prog.a.data[i], -1);
-        } else if (strcmp(constrainType, "=") == 0) {
-            
-            // Grow arrays
-            grow_array((void**)&bufBounds, addBuffCount, sizeof(double), addBuffCount + 1);
-            grow_array((void**)&bufCons, addBuffCount, sizeof(vector), addBuffCount + 1);
+    // Stale pricing state
+    dic_release(&dic, dic.weights);
+    dic.weights = 0;
+    dic.price.count = 0;
+    dic.state = SIMPLEX_STATE_FEASIBLE;
+
+    if (primal) {
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, "Warm start: primal simplex\n");
+        STATS_PHASE(1);
+        return phase_two(dic);
+    }
+    if (dual) {
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, "Warm start: dual simplex\n");
+        dic.state = dual_simplex(&dic);
+        log_state(out, dic.state);
+        return dic;
+    }
+    if (out->level >= VERBOSITY_NORMAL)
+        wr_printf(out, "Warm start basis is neither primal nor dual feasible, solving from scratch\n");
+    freedic(&dic);
+    return simplex(c, b, a, sense, vb, dic.ctx, out);
 
-            // Set constraint and bounds for '<=' ==> we need to do * -1 to convert it to standard form
-            bufBounds[addBuffCount] = -prog.b.data[i];
-            vec_copy(&prog.a.data[i], &bufCons[addBuffCount]);
-            vec_mul(&bufCons[addBuffCount], -1);
+}
 
-            // Increment count
-            addBuffCount++;
+// Solve a problem starting from a saved basis.
+dictionary simplex_warm(vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb, basis* start, simplex_context* ctx, writer* out) {
+    if (start->varc != c->size || start->rows != b->size) {
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, "Saved basis does not fit the problem, solving from scratch\n");
+        return simplex(c, b, a, sense, vb, ctx, out);
+    }
+    dictionary dic = create_dic(c, b, a, sense, vb, ctx);
+    dic.out = out;
+    int pivots = install_basis(&dic, start);
+    dic.iterations = 0;
+    if (out->level >= VERBOSITY_NORMAL)
+        wr_printf(out, "Installed the saved basis with %i pivots\n", pivots);
+    dic.state = drive_out_equalities(&dic);
+    if (dic.state == SIMPLEX_STATE_INFEASIBLE) {
+        log_state(out, dic.state);
+        return dic;
+    }
+    return continue_from(dic, c, b, a, sense, vb);
+}
 
-        } else if (strcmp(constrainType, "<=") != 0) {
-            fprintf(stderr, "Invalid constraint type '%s'\n", constrainType);
-            return prog;
+// Re-optimize a solved dictionary for a new objective 'c' and new bounds 'b' of the same constraints 'a'.
+// The basis is kept: the bound column is rebuilt from the columns of the slack variables, which hold the
+// inverse of the basis, and the objective row from the rows of the decision variables.
+// Problems with variable bounds 'vb' are solved again from scratch.
+dictionary reoptimize(dictionary d, vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb) {
+
+    if (d.dic.rows != b->size + 1 || d.varc != c->size || d.dic.columns != c->size + 1 || d.forms || vb) {
+        // Not a complete tableau of the problem (a redundant row was dropped in phase one, phase one
+        // failed, or the dictionary came from the revised engine), or one with variables at upper bounds
+        freedic(&d);
+        return simplex(c, b, a, sense, vb, d.ctx, d.out);
+    }
+    int rows = d.dic.rows, n = d.varc;
+
+    // Bound column: B^-1 b from the slack columns
+    double* beta = (double*)context_alloc(d.ctx, sizeof(double) * rows);
+    memset(beta, 0, sizeof(double) * rows);
+    for (int i = 0; i < b->size; i++) {
+        int w = n + 1 + i;
+        int j = index_of(d.vars, w, 0, n);
+        if (j != -1) {
+            for (int r = 0; r < rows; r++)
+                beta[r] -= b->data[i] * mat_row(&d.dic, r)[j + 1];
+        } else {
+            beta[index_of(d.vars, w, n, n + rows - 1) - n + 1] += b->data[i];
         }
-
     }
+    for (int r = 0; r < rows; r++)
+        mat_row(&d.dic, r)[0] = beta[r];
+    context_release(d.ctx, beta);
 
-    // Close file
-    fclose(pFile);
+    // Objective row (and its constant c_B B^-1 b)
+    set_objective(&d, c);
 
-    // Append if needed
-    if (bufBounds && bufCons) {
-        
-        // Add to bounds
-        vector b = vec(prog.b.size + (int)addBuffCount);
-        memcpy(b.data, prog.b.data, sizeof(double) * prog.b.size);
-        memcpy(b.data + prog.b.size, bufBounds, sizeof(double) * addBuffCount);
+    return continue_from(d, c, b, a, sense, vb);
 
-        // Free old bounds array and set new
-        freevec(&prog.b);
-        prog.b = b;
-        //printf()
+}
 
-        // Add constraint rows
-        mat_addrows(&prog.a, addBuffCount, bufCons);
+// Refactorize the basis after this many updates in the revised simplex method
+#define REVISED_REFACTOR 64
 
-    }
+// Tolerance on reduced costs and pivot elements in the revised simplex method
+#define REVISED_EPS 1e-9
 
-    // Set mode
-    if (strcmp(minmax, "max") == 0){
-        prog.max = 1;
-    } else if (strcmp(minmax, "min") == 0) {
-        prog.max = 0; // Is minimise
-        // Negative all coefficients
-        for (int i = 0; i < prog.c.size; i++)
-            prog.c.data[i] *= -1;
+// A basis update in product form: the entering column in terms of the old basis
+typedef struct {
+    int p; // The basis position that was replaced
+    double pivot; // The entry of the column at position p
+    int nz; // The amount of nonzeros besides the pivot
+    int* index; // The positions of the nonzeros (in the eta pool)
+    double* value; // The nonzero values (in the eta pool)
+} eta;
+
+// State of the revised simplex method.
+// Variable 0 is the auxiliary x0, 1 to n the decision variables and n + 1 to n + m the slack variables.
+// Slack columns in the basis are unit columns, so only the kernel of the basis (the other basic columns
+// restricted to the rows no basic slack covers) is factorized.
+typedef struct {
+    int m; // The amount of constraints
+    int n; // The amount of decision variables
+    vector* b; // The bounds (not owned)
+    spmatrix* a; // The constraint matrix (not owned)
+    signed char* sense; // The type of every row (not owned, 0 if all are <=), equality slacks are fixed at zero
+    double* cost; // The objective coefficient of every variable in the current phase
+    double* lower; // The lower bound of every variable (-INFINITY if none)
+    double* upper; // The upper bound of every variable (INFINITY if none)
+    double* value; // The value of every nonbasic variable: one of its bounds, or 0 if it is free
+    int first; // The first variable that may enter the basis (0 while x0 is allowed)
+    int* basis; // The variable in each basis position
+    int* position; // The basis position of every variable (-1 if nonbasic)
+    double* x; // The values of the basic variables
+    int k; // The size of the kernel
+    int* slack; // The row of the slack at every basis position at the last refactorization (-1 for kernel columns)
+    int* kvar; // The variables of the kernel columns
+    int* kpos; // The basis positions of the kernel columns
+    int* krow; // The rows of the kernel
+    int* kindex; // The kernel row of every row (-1 if covered by a basic slack)
+    matrix lu; // LU factors of the kernel at the last refactorization (unit lower part)
+    size_t luSize; // The amount of doubles the storage of the LU factors holds, it is reused while the kernel fits
+    int* perm; // Row 'i' of the LU factors is kernel row perm[i]
+    eta etas[REVISED_REFACTOR]; // Updates since the last refactorization
+    int etac; // The amount of updates
+    int* etaIndex; // The positions of the nonzeros of all updates (room for REVISED_REFACTOR full columns)
+    double* etaValue; // The values of the nonzeros of all updates
+    size_t etaUsed; // The amount of entries of the pool in use
+    double* y; // The simplex multipliers
+    double* alpha; // The entering column in terms of the basis
+    double* d; // The reduced costs
+    double* work; // Scratch space
+    double* work2; // Scratch space
+    price_state price; // Partial and multiple pricing state
+    int iteration; // The amount of pivots so far
+    int state; // The current state (SIMPLEX_STATE_*)
+    writer* out; // Where logs are written
+    simplex_context* ctx; // Where all of the above is allocated (0 for the heap), not owned
+} revised;
+
+// Add 'f' times column 'j' of [A I] (the column of x0 is all -1) to 'out'.
+void revised_axpy(revised* r, int j, double f, double* out) {
+    if (j == 0) {
+        for (int i = 0; i < r->m; i++)
+            out[i] -= f;
+    } else if (j <= r->n) {
+        for (int k = r->a->start[j - 1]; k < r->a->start[j]; k++)
+            out[r->a->index[k]] += f * r->a->value[k];
     } else {
-        fprintf(stderr, "Invalid objective goal '%s'.\n", minmax);
+        out[j - r->n - 1] += f;
     }
-
-    // Return problem
-    return prog;
-
 }
 
-int main(int argc, char** args) {
-    
-    // Print usage if no arguments are provided
-    if (argc == 1) {
-        printf("No problem file supplied in arguments.\n");
+// Get the dot product of column 'j' of [A I] and 'y'.
+double revised_dot(revised* r, int j, double* y) {
+    double s = 0;
+    if (j == 0) {
+        for (int i = 0; i < r->m; i++)
+            s -= y[i];
+    } else if (j <= r->n) {
+        for (int k = r->a->start[j - 1]; k < r->a->start[j]; k++)
+            s += y[r->a->index[k]] * r->a->value[k];
+    } else {
+        s = y[j - r->n - 1];
+    }
+    return s;
+}
+
+// Write column 'j' of [A I] into 'out'.
+void revised_column(revised* r, int j, double* out) {
+    memset(out, 0, sizeof(double) * r->m);
+    revised_axpy(r, j, 1, out);
+}
+
+// Solve B v' = v in place ('v' is indexed by row on input and by basis position on output).
+void revised_ftran(revised* r, double* v) {
+
+    // Solve the kernel: permute and forward substitute with L, then back substitute with U
+    double* t = r->work;
+    for (int i = 0; i < r->k; i++) {
+        double* row = mat_row(&r->lu, i);
+        double s = v[r->krow[r->perm[i]]];
+        for (int k = 0; k < i; k++)
+            s -= row[k] * t[k];
+        t[i] = s;
+    }
+    for (int i = r->k - 1; i >= 0; i--) {
+        double* row = mat_row(&r->lu, i);
+        double s = t[i];
+        for (int k = i + 1; k < r->k; k++)
+            s -= row[k] * t[k];
+        t[i] = s / row[i];
+    }
+
+    // The basic slacks take up what is left of their rows
+    for (int i = 0; i < r->k; i++)
+        if (t[i] != 0)
+            revised_axpy(r, r->kvar[i], -t[i], v);
+    double* out = r->work2;
+    for (int p = 0; p < r->m; p++)
+        if (r->slack[p] != -1)
+            out[p] = v[r->slack[p]];
+    for (int i = 0; i < r->k; i++)
+        out[r->kpos[i]] = t[i];
+    memcpy(v, out, sizeof(double) * r->m);
+
+    // Apply the updates in order
+    for (int k = 0; k < r->etac; k++) {
+        eta* e = &r->etas[k];
+        double vp = v[e->p] / e->pivot;
+        if (vp != 0)
+            for (int i = 0; i < e->nz; i++)
+                v[e->index[i]] -= e->value[i] * vp;
+        v[e->p] = vp;
+    }
+
+}
+
+// Solve B^T v' = v in place ('v' is indexed by basis position on input and by row on output).
+void revised_btran(revised* r, double* v) {
+
+    // Apply the updates in reverse order
+    for (int k = r->etac - 1; k >= 0; k--) {
+        eta* e = &r->etas[k];
+        double s = v[e->p];
+        for (int i = 0; i < e->nz; i++)
+            s -= e->value[i] * v[e->index[i]];
+        v[e->p] = s / e->pivot;
+    }
+
+    // The multipliers of rows covered by a basic slack are given directly
+    double* y = r->work2;
+    memset(y, 0, sizeof(double) * r->m);
+    for (int p = 0; p < r->m; p++)
+        if (r->slack[p] != -1)
+            y[r->slack[p]] = v[p];
+
+    // Right hand side of the kernel system
+    double* t = r->work;
+    for (int i = 0; i < r->k; i++)
+        t[i] = v[r->kpos[i]] - revised_dot(r, r->kvar[i], y);
+
+    // Forward substitute with U^T and back substitute with L^T (row oriented), then undo the permutation
+    for (int i = 0; i < r->k; i++) {
+        double* row = mat_row(&r->lu, i);
+        t[i] /= row[i];
+        if (t[i] != 0)
+            for (int k = i + 1; k < r->k; k++)
+                t[k] -= row[k] * t[i];
+    }
+    for (int i = r->k - 1; i >= 0; i--) {
+        double* row = mat_row(&r->lu, i);
+        if (t[i] != 0)
+            for (int k = 0; k < i; k++)
+                t[k] -= row[k] * t[i];
+    }
+    for (int i = 0; i < r->k; i++)
+        y[r->krow[r->perm[i]]] = t[i];
+    memcpy(v, y, sizeof(double) * r->m);
+
+}
+
+// Drop all basis updates.
+void revised_clear_etas(revised* r) {
+    r->etac = 0;
+    r->etaUsed = 0;
+}
+
+// Factorize the kernel of the current basis and recompute the basic variables.
+// Returns 0 if the basis is singular.
+int revised_factor(revised* r) {
+
+    // Split the basis into slack columns and kernel columns
+    for (int i = 0; i < r->m; i++)
+        r->kindex[i] = 0;
+    r->k = 0;
+    for (int p = 0; p < r->m; p++) {
+        if (r->basis[p] > r->n) {
+            r->slack[p] = r->basis[p] - r->n - 1;
+            r->kindex[r->slack[p]] = -1;
+        } else {
+            r->slack[p] = -1;
+            r->kvar[r->k] = r->basis[p];
+            r->kpos[r->k++] = p;
+        }
+    }
+    int rows = 0;
+    for (int i = 0; i < r->m; i++)
+        if (r->kindex[i] != -1) {
+            r->kindex[i] = rows;
+            r->krow[rows++] = i;
+        }
+    if (rows != r->k)
+        return 0;
+
+    // Gather the kernel, in the storage of the last factors if it fits
+    size_t size = (size_t)mat_stride(r->k) * r->k;
+    if (size > r->luSize) {
+        if (r->lu.data)
+            context_release(r->ctx, r->lu.data);
+        r->luSize = size > 2 * r->luSize ? size : 2 * r->luSize;
+        r->lu.data = (double*)context_alloc(r->ctx, sizeof(double) * r->luSize);
+        STATS_PEAK((sizeof(double) + sizeof(int)) * REVISED_REFACTOR * (size_t)r->m + sizeof(double) * r->luSize);
+    }
+    STATS_ADD(refactors, 1);
+    r->lu.rows = r->k;
+    r->lu.columns = r->k;
+    r->lu.stride = mat_stride(r->k);
+    for (int i = 0; i < r->k; i++) {
+        memset(mat_row(&r->lu, i), 0, sizeof(double) * r->k);
+        r->perm[i] = i;
+    }
+    for (int c = 0; c < r->k; c++) {
+        int j = r->kvar[c];
+        if (j == 0) {
+            for (int i = 0; i < r->k; i++)
+                mat_row(&r->lu, i)[c] = -1;
+        } else {
+            for (int k = r->a->start[j - 1]; k < r->a->start[j]; k++)
+                if (r->kindex[r->a->index[k]] != -1)
+                    mat_row(&r->lu, r->kindex[r->a->index[k]])[c] += r->a->value[k];
+        }
+    }
+
+    // Gaussian elimination with partial pivoting
+    for (int k = 0; k < r->k; k++) {
+        int p = k;
+        for (int i = k + 1; i < r->k; i++)
+            if (fabs(mat_row(&r->lu, i)[k]) > fabs(mat_row(&r->lu, p)[k]))
+                p = i;
+        if (fabs(mat_row(&r->lu, p)[k]) < 1e-12)
+            return 0;
+        if (p != k) {
+            double* a = mat_row(&r->lu, p);
+            double* b = mat_row(&r->lu, k);
+            for (int j = 0; j < r->k; j++) {
+                double tmp = a[j];
+                a[j] = b[j];
+                b[j] = tmp;
+            }
+            int tmp = r->perm[p];
+            r->perm[p] = r->perm[k];
+            r->perm[k] = tmp;
+        }
+        double* prow = mat_row(&r->lu, k);
+        for (int i = k + 1; i < r->k; i++) {
+            double* row = mat_row(&r->lu, i);
+            if (row[k] == 0)
+                continue;
+            double l = row[k] / prow[k];
+            row_update(row + k + 1, prow + k + 1, -l, r->k - k - 1);
+            row[k] = l;
+        }
+    }
+
+    // Recompute the basic variables from scratch to remove accumulated drift
+    revised_clear_etas(r);
+    memcpy(r->x, r->b->data, sizeof(double) * r->m);
+    for (int j = 0; j <= r->n + r->m; j++)
+        if (r->position[j] == -1 && r->value[j] != 0)
+            revised_axpy(r, j, -r->value[j], r->x);
+    revised_ftran(r, r->x);
+    return 1;
+
+}
+
+// Replace the variable at basis position 'p' by 'q', r->alpha must hold the column of 'q' in terms of the basis.
+// The leaving variable becomes nonbasic at the value 'target' (one of its bounds).
+void revised_pivot(revised* r, int q, int p, double target) {
+
+    // Update the basic variables
+    STATS_CLOCK(start);
+    double t = (r->x[p] - target) / r->alpha[p];
+    for (int i = 0; i < r->m; i++)
+        r->x[i] -= t * r->alpha[i];
+    r->x[p] = r->value[q] + t;
+    r->value[r->basis[p]] = target;
+
+    // Update the basis
+    r->position[r->basis[p]] = -1;
+    r->position[q] = p;
+    r->basis[p] = q;
+
+    // Store the update or refactorize if enough have been stored
+    if (r->etac == REVISED_REFACTOR) {
+        if (!revised_factor(r))
+            r->state = SIMPLEX_STATE_INFEASIBLE;
+        STATS_TIME(update, start);
+        return;
+    }
+    eta* e = &r->etas[r->etac++];
+    e->p = p;
+    e->pivot = r->alpha[p];
+    e->nz = 0;
+    e->index = r->etaIndex + r->etaUsed;
+    e->value = r->etaValue + r->etaUsed;
+    for (int i = 0; i < r->m; i++)
+        if (i != p && r->alpha[i] != 0) {
+            e->index[e->nz] = i;
+            e->value[e->nz++] = r->alpha[i];
+        }
+    r->etaUsed += e->nz;
+    STATS_TIME(update, start);
+
+}
+
+// Compute the simplex multipliers y = c_B B^-1 of the current basis.
+void revised_multipliers(revised* r) {
+    for (int i = 0; i < r->m; i++)
+        r->y[i] = r->cost[r->basis[i]];
+    revised_btran(r, r->y);
+}
+
+// Check if variable 'j' is the slack of an equality row, which never enters the basis.
+int revised_fixed(revised* r, int j) {
+    return j > r->n && r->sense && r->sense[j - r->n - 1] == SENSE_EQ;
+}
+
+// Score of variable 'j' for pricing: the size of its reduced cost d = c - y [A I] (stored in r->d) if
+// moving away from its value in the direction of d improves the objective, else 0.
+double revised_score(void* ctx, int j) {
+    revised* r = (revised*)ctx;
+    if (r->position[j] != -1 || revised_fixed(r, j))
+        return 0;
+    double d = r->d[j] = r->cost[j] - revised_dot(r, j, r->y);
+    if (d > REVISED_EPS && r->value[j] < r->upper[j])
+        return d;
+    return d < -REVISED_EPS && r->value[j] > r->lower[j] ? -d : 0;
+}
+
+// Get the objective value of the current basis.
+double revised_objective(revised* r) {
+    double z = 0;
+    for (int i = 0; i < r->m; i++)
+        z += r->cost[r->basis[i]] * r->x[i];
+    for (int j = 0; j <= r->n + r->m; j++)
+        if (r->position[j] == -1 && r->value[j] != 0)
+            z += r->cost[j] * r->value[j];
+    return z;
+}
+
+// Get how far the entering variable can move in direction 'dir' before basic variable 'i' goes 'relax'
+// beyond one of its bounds (INFINITY if never, or if its entry of alpha is below the pivot tolerance).
+double revised_ratio(revised* r, int i, double dir, double relax) {
+    double rate = -dir * r->alpha[i];
+    int v = r->basis[i];
+    if (rate <= -tolerance_opts.pivot && r->lower[v] > -INFINITY)
+        return ((r->x[i] > r->lower[v] ? r->x[i] - r->lower[v] : 0) + relax) / -rate;
+    if (rate >= tolerance_opts.pivot && r->upper[v] < INFINITY)
+        return ((r->x[i] < r->upper[v] ? r->upper[v] - r->x[i] : 0) + relax) / rate;
+    return INFINITY;
+}
+
+// Run the primal simplex method on the current (feasible) basis.
+// Degenerate stalls fall back to Bland's rule like the tableau engine, and the phase stops at the iteration limit.
+void revised_phase(revised* r) {
+
+    char ev[VAR_NAME_SIZE];
+    char lv[VAR_NAME_SIZE];
+    r->price.count = 0; // Candidates of an earlier phase were priced with other costs
+    long limit = iteration_limit(r->m, r->n + r->m), iterations = 0;
+    int stalls = 0, bland = 0;
+    while (r->state == SIMPLEX_STATE_FEASIBLE) {
+
+        if (iterations++ == limit) {
+            r->state = SIMPLEX_STATE_ITERATION_LIMIT;
+            break;
+        }
+
+        // Pricing (largest reduced cost, over a window or the candidates with partial or multiple pricing),
+        // or the smallest variable with a positive reduced cost under Bland's rule
+        STATS_CLOCK(start);
+        revised_multipliers(r);
+        int q = -1;
+        if (bland) {
+            for (int j = r->first; j <= r->n + r->m && q == -1; j++)
+                if (revised_score(r, j) > 0)
+                    q = j;
+        } else {
+            q = price_scan(&r->price, r->first, r->n + r->m, revised_score, r);
+        }
+        STATS_TIME(pricing, start);
+        if (q == -1) {
+            r->state = SIMPLEX_STATE_SUCCESS;
+            break;
+        }
+
+        // Entering column in terms of the basis
+        STATS_CLOCK(ratio);
+        revised_column(r, q, r->alpha);
+        revised_ftran(r, r->alpha);
+
+        // Ratio test: the entering variable moves in direction 's' and basic variable i changes by
+        // -s alpha[i] per unit, until one of them reaches a bound
+        double dir = r->d[q] > 0 ? 1 : -1;
+        int harris = tolerance_opts.harris && !bland;
+        int p = -1;
+        double minRatio = INFINITY;
+        for (int i = 0; i < r->m; i++) {
+            double ratio = revised_ratio(r, i, dir, harris ? tolerance_opts.primal : 0);
+            if (ratio < minRatio || (bland && ratio == minRatio && r->basis[i] < r->basis[p])) {
+                minRatio = ratio;
+                p = i;
+            }
+        }
+
+        // Harris' second pass: the largest pivot among the rows that block within the relaxed step
+        if (harris && p != -1) {
+            double bound = minRatio, best = 0;
+            for (int i = 0; i < r->m; i++) {
+                double ratio = revised_ratio(r, i, dir, 0);
+                if (ratio <= bound && fabs(r->alpha[i]) > best) {
+                    best = fabs(r->alpha[i]);
+                    minRatio = ratio;
+                    p = i;
+                }
+            }
+        }
+
+        // The entering variable can reach its other bound first (a bound flip without a basis change)
+        STATS_TIME(ratio, ratio);
+        var_name(r->n, ev, q);
+        double span = r->upper[q] - r->lower[q];
+        if ((span < INFINITY && span <= minRatio) || p != -1)
+            STATS_ITERATION((span < minRatio ? span : minRatio) <= REVISED_EPS);
+        if (span < INFINITY && span <= minRatio) {
+            for (int i = 0; i < r->m; i++)
+                r->x[i] -= dir * span * r->alpha[i];
+            r->value[q] += dir * span;
+            minRatio = span;
+            r->iteration++;
+            if (r->out->level >= VERBOSITY_NORMAL)
+                wr_printf(r->out, "Iteration %i: %s moving to its other bound, objective %.4f\n", r->iteration, ev, revised_objective(r));
+        } else if (p == -1) {
+            r->state = SIMPLEX_STATE_UNBOUNDED;
+            break;
+        } else {
+
+            // Pivot and log
+            int v = r->basis[p];
+            var_name(r->n, lv, v);
+            revised_pivot(r, q, p, -dir * r->alpha[p] < 0 ? r->lower[v] : r->upper[v]);
+            r->iteration++;
+            if (r->out->level >= VERBOSITY_NORMAL)
+                wr_printf(r->out, "Iteration %i: %s entering, %s leaving, objective %.4f\n", r->iteration, ev, lv, revised_objective(r));
+
+        }
+
+        // Handle degeneracy
+        if (minRatio > REVISED_EPS) {
+            stalls = 0;
+            bland = 0;
+        } else if (++stalls == degeneracy_opts.stall && !bland) {
+            stalls = 0;
+            bland = 1;
+            if (r->out->level >= VERBOSITY_NORMAL)
+                wr_printf(r->out, "Degenerate vertex, using Bland's rule\n");
+        }
+
+    }
+
+}
+
+// Drive variable 'v' (x0 or the slack of an equality row, at zero) out of the basis after a successful
+// auxiliary problem.
+void revised_drive_out(revised* r, int v) {
+
+    int p = r->position[v];
+    if (p == -1)
+        return;
+
+    // Row p of B^-1 [A I] for every nonbasic variable, pick the largest entry
+    memset(r->y, 0, sizeof(double) * r->m);
+    r->y[p] = 1;
+    revised_btran(r, r->y);
+    int q = -1;
+    double best = REVISED_EPS;
+    for (int j = 1; j <= r->n + r->m; j++) {
+        if (r->position[j] != -1 || revised_fixed(r, j))
+            continue;
+        double e = fabs(revised_dot(r, j, r->y));
+        if (e > best) {
+            best = e;
+            q = j;
+        }
+    }
+
+    // A redundant constraint leaves the variable basic at zero
+    if (q == -1)
+        return;
+    revised_column(r, q, r->alpha);
+    revised_ftran(r, r->alpha);
+    revised_pivot(r, q, p, 0);
+
+}
+
+// Solve the problem with the revised simplex method, starting from basis 'start' if it is not 0 and the
+// basis is feasible for the problem (phase one is skipped then). The nonbasic decision variables j of the
+// basis rest at their lower bound, or at their upper bound if 'upper' is not 0 and upper[j - 1] is set.
+// Rows whose 'sense' is SENSE_EQ are equalities: their slacks start basic, are minimized along with x0
+// in phase one and never enter again.
+// The returned dictionary only holds the constant column (the objective and basic values).
+dictionary revised_solve(vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb, basis* start, const char* upper, simplex_context* ctx, writer* out) {
+
+    // Setup, starting from the slack basis. Everything an iteration needs is allocated here (the LU
+    // factors when the kernel outgrows them), from 'ctx' or the heap if it is 0.
+    STATS_CLOCK(setup);
+    revised r;
+    r.m = b->size;
+    r.n = c->size;
+    r.b = b;
+    r.a = a;
+    r.sense = sense;
+    r.ctx = ctx;
+    int vars = r.n + r.m + 1;
+    int size = r.m > 0 ? r.m : 1;
+    r.cost = (double*)context_alloc(ctx, sizeof(double) * vars);
+    r.position = (int*)context_alloc(ctx, sizeof(int) * vars);
+    r.d = (double*)context_alloc(ctx, sizeof(double) * vars);
+    r.basis = (int*)context_alloc(ctx, sizeof(int) * size);
+    r.slack = (int*)context_alloc(ctx, sizeof(int) * size);
+    r.kvar = (int*)context_alloc(ctx, sizeof(int) * size);
+    r.kpos = (int*)context_alloc(ctx, sizeof(int) * size);
+    r.krow = (int*)context_alloc(ctx, sizeof(int) * size);
+    r.kindex = (int*)context_alloc(ctx, sizeof(int) * size);
+    r.perm = (int*)context_alloc(ctx, sizeof(int) * size);
+    r.x = (double*)context_alloc(ctx, sizeof(double) * size);
+    r.y = (double*)context_alloc(ctx, sizeof(double) * size);
+    r.alpha = (double*)context_alloc(ctx, sizeof(double) * size);
+    r.work = (double*)context_alloc(ctx, sizeof(double) * size);
+    r.work2 = (double*)context_alloc(ctx, sizeof(double) * size);
+    r.lower = (double*)context_alloc(ctx, sizeof(double) * vars);
+    r.upper = (double*)context_alloc(ctx, sizeof(double) * vars);
+    r.value = (double*)context_alloc(ctx, sizeof(double) * vars);
+    r.lu.rows = r.lu.columns = r.lu.stride = 0;
+    r.lu.data = 0;
+    r.luSize = 0;
+    r.etac = 0;
+    r.etaIndex = (int*)context_alloc(ctx, sizeof(int) * REVISED_REFACTOR * (size_t)size);
+    r.etaValue = (double*)context_alloc(ctx, sizeof(double) * REVISED_REFACTOR * (size_t)size);
+    r.etaUsed = 0;
+    price_init(&r.price, ctx);
+    r.iteration = 0;
+    r.state = SIMPLEX_STATE_FEASIBLE;
+    r.out = out;
+    for (int j = 0; j < vars; j++) {
+        r.position[j] = -1;
+        r.lower[j] = 0;
+        r.upper[j] = INFINITY;
+        if (vb && j >= 1 && j <= r.n) {
+            r.lower[j] = vb->lower[j - 1];
+            r.upper[j] = vb->upper[j - 1];
+        }
+        r.value[j] = isfinite(r.lower[j]) ? r.lower[j] : isfinite(r.upper[j]) ? r.upper[j] : 0;
+    }
+    for (int i = 0; i < r.m; i++) {
+        r.basis[i] = r.n + 1 + i;
+        r.position[r.n + 1 + i] = i;
+    }
+
+    // Warm start from the saved basis if it factorizes and is feasible, otherwise from the slack basis
+    // (which is factorized here, a kept warm start basis already is)
+    int factored = 0;
+    if (start && start->varc == r.n && start->rows == r.m) {
+        for (int i = 0; i < r.m; i++)
+            r.position[r.basis[i]] = -1;
+        for (int i = 0; i < r.m; i++) {
+            r.basis[i] = start->vars[r.n + i];
+            r.position[r.basis[i]] = i;
+        }
+        for (int j = 1; j <= r.n && upper; j++)
+            if (upper[j - 1] && r.position[j] == -1 && r.upper[j] < INFINITY)
+                r.value[j] = r.upper[j];
+        int feasible = revised_factor(&r);
+        for (int i = 0; i < r.m && feasible; i++)
+            feasible = r.x[i] >= r.lower[r.basis[i]] - REVISED_EPS && r.x[i] <= r.upper[r.basis[i]] + REVISED_EPS &&
+                       (!revised_fixed(&r, r.basis[i]) || r.x[i] <= REVISED_EPS);
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, feasible ? "Warm start: primal simplex\n" : "Starting basis is not feasible, solving from scratch\n");
+        if (!feasible) {
+            for (int i = 0; i < r.m; i++)
+                r.position[r.basis[i]] = -1;
+            for (int i = 0; i < r.m; i++) {
+                r.basis[i] = r.n + 1 + i;
+                r.position[r.n + 1 + i] = i;
+            }
+            for (int j = 1; j <= r.n; j++)
+                r.value[j] = isfinite(r.lower[j]) ? r.lower[j] : isfinite(r.upper[j]) ? r.upper[j] : 0;
+        }
+        factored = feasible;
+    }
+    if (!factored)
+        revised_factor(&r);
+    STATS_TIME(create, setup);
+
+    // Phase one: bring x0 into the most infeasible row and minimize it, along with the basic slacks of
+    // equality rows
+    int p = -1, fixed = 0;
+    for (int i = 0; i < r.m; i++) {
+        if (r.x[i] < r.lower[r.basis[i]] - REVISED_EPS && (p == -1 || r.x[i] < r.x[p]))
+            p = i;
+        fixed |= revised_fixed(&r, r.basis[i]) && r.x[i] > REVISED_EPS;
+    }
+    int log = out->level >= VERBOSITY_NORMAL;
+    if (p == -1 && !fixed) {
+        if (log)
+            wr_printf(out, "Skipping Phase One\n");
+    } else {
+        if (log)
+            wr_printf(out, "--- Solving Auxiliary Problem ---\n");
+        memset(r.cost, 0, sizeof(double) * vars);
+        r.cost[0] = -1;
+        for (int j = r.n + 1; j < vars; j++)
+            r.cost[j] = revised_fixed(&r, j) ? -1 : 0;
+        r.first = 0;
+        if (p != -1) {
+            revised_column(&r, 0, r.alpha);
+            revised_ftran(&r, r.alpha);
+            if (log) {
+                char lv[VAR_NAME_SIZE];
+                var_name(r.n, lv, r.basis[p]);
+                wr_printf(out, "Iteration 0: x0 entering, %s leaving, objective %.4f\n", lv, r.x[p] / r.alpha[p] * -1);
+            }
+            revised_pivot(&r, 0, p, 0);
+        }
+        revised_phase(&r);
+        if (r.state == SIMPLEX_STATE_SUCCESS && revised_objective(&r) < -REVISED_EPS)
+            r.state = SIMPLEX_STATE_INFEASIBLE;
+        if (r.state == SIMPLEX_STATE_SUCCESS) {
+            if (log)
+                wr_printf(out, "--- Auxiliary Problem Solved ---\n");
+            revised_drive_out(&r, 0);
+            for (int j = r.n + 1; j < vars; j++)
+                if (revised_fixed(&r, j))
+                    revised_drive_out(&r, j);
+            r.state = SIMPLEX_STATE_FEASIBLE;
+            if (log)
+                wr_printf(out, "---   Solving Main Problem   ---\n\n");
+        } else if (r.state != SIMPLEX_STATE_ITERATION_LIMIT) {
+            r.state = SIMPLEX_STATE_INFEASIBLE;
+        }
+    }
+
+    // Phase two with the real objective. The slacks of equality rows are at zero by now, and an upper bound
+    // of zero keeps one that is still basic (of a redundant row) there in the ratio test.
+    if (r.state == SIMPLEX_STATE_FEASIBLE) {
+        for (int j = r.n + 1; j < vars; j++)
+            if (revised_fixed(&r, j))
+                r.upper[j] = 0;
+        r.cost[0] = 0;
+        for (int j = 0; j < r.n; j++)
+            r.cost[j + 1] = c->data[j];
+        for (int i = 0; i < r.m; i++)
+            r.cost[r.n + 1 + i] = 0;
+        r.first = 1;
+        STATS_PHASE(1);
+        revised_phase(&r);
+    }
+    switch (log ? r.state : SIMPLEX_STATE_FEASIBLE) {
+    case SIMPLEX_STATE_SUCCESS:
+        wr_printf(out, "--- Simplex Terminating (Success) ---\n\n");
+        break;
+    case SIMPLEX_STATE_INFEASIBLE:
+        wr_printf(out, "--- Simplex Terminating (Infeasible) ---\n\n");
+        break;
+    case SIMPLEX_STATE_UNBOUNDED:
+        wr_printf(out, "--- Simplex Terminating (Unbounded) ---\n\n");
+        break;
+    case SIMPLEX_STATE_ITERATION_LIMIT:
+        wr_printf(out, "--- Simplex Terminating (Iteration Limit) ---\n\n");
+        break;
+    }
+
+    // Build the result in dictionary form: nonbasic variables first, then one row per basic variable
+    dictionary d;
+    d.varc = r.n;
+    d.ctx = ctx;
+    d.state = r.state;
+    d.out = out;
+    d.weights = 0;
+    d.iterations = r.iteration;
+    price_init(&d.price, ctx);
+    d.bland = 0;
+    d.perturb = 0;
+    d.fixed = 0;
+    d.forms = 0;
+    d.post = 0;
+    d.scale = 0;
+    d.dic = mat_in(ctx, r.m + 1, 1);
+    d.vars = (int*)context_alloc(ctx, sizeof(int) * ((size_t)r.n + r.m));
+    int k = 0;
+    for (int j = 1; j <= r.n + r.m && k < r.n; j++)
+        if (r.position[j] == -1)
+            d.vars[k++] = j;
+    for (int i = 0; i < r.m; i++) {
+        d.vars[r.n + i] = r.basis[i];
+        mat_row(&d.dic, i + 1)[0] = r.x[i];
+    }
+    mat_row(&d.dic, 0)[0] = revised_objective(&r);
+
+    // Nonbasic variables resting at a nonzero bound are reported through their offset
+    if (vb) {
+        d.forms = (var_form*)context_alloc(ctx, sizeof(var_form) * ((size_t)r.n + r.m + 1));
+        for (int j = 0; j <= r.n + r.m; j++) {
+            var_form f = { r.upper[j], r.position[j] == -1 ? r.value[j] : 0, 1, 0 };
+            d.forms[j] = f;
+        }
+    }
+
+    // Cleanup
+    void* buffers[] = { r.cost, r.position, r.d, r.basis, r.slack, r.kvar, r.kpos, r.krow, r.kindex, r.perm, r.x, r.y,
+                        r.alpha, r.work, r.work2, r.lower, r.upper, r.value, r.etaIndex, r.etaValue, r.lu.data };
+    for (int i = 0; i < (int)(sizeof(buffers) / sizeof(buffers[0])); i++)
+        if (buffers[i])
+            context_release(ctx, buffers[i]);
+    price_free(&r.price);
+
+    return d;
+
+}
+
+// Solve the problem with the revised simplex method, starting from a saved basis if 'start' is not 0
+// (see revised_solve).
+dictionary revised_simplex(vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb, basis* start, simplex_context* ctx, writer* out) {
+    return revised_solve(c, b, a, sense, vb, start, 0, ctx, out);
+}
+
+// Tolerance of the interior point method on the relative primal and dual infeasibility and duality gap
+#define IPM_EPS 1e-8
+
+// The most predictor-corrector steps before the interior point method gives up
+#define IPM_MAX_STEPS 200
+
+// The fraction of the way to the boundary of the positive orthant that a step goes
+#define IPM_STEP 0.995
+
+// The amount of steps without progress (the largest of the infeasibilities and the gap down by a tenth)
+// after which the interior point method gives up
+#define IPM_STALL 20
+
+// The width of the block columns of the dense Cholesky factorization. The block of a row is 512 bytes, so
+// the panel that the trailing rows are updated with stays in the cache up to a few thousand rows.
+#define CHOLESKY_BLOCK 64
+
+// A pivot of the Cholesky factorization that cancels below this fraction of its diagonal entry belongs to a
+// (nearly) dependent row
+#define CHOLESKY_TINY 1e-14
+
+// A problem in the form the interior point method takes: minimize c'x subject to Ax = b and 0 <= x <= u.
+// Every decision variable is one column shifted by its lower bound (mirrored at its upper bound if that is
+// its only bound), two columns x+ - x- if it is free, or none if it is fixed. Every inequality row has a
+// slack column.
+typedef struct {
+    int m; // The amount of rows
+    int n; // The amount of columns
+    spmatrix a; // The constraints, every column in row order without repeated rows
+    int* rowStart; // Row 'i' of the constraints is entries rowStart[i] to rowStart[i + 1] - 1 of the two below
+    int* rowEntry; // The entries of the constraints (into a.index and a.value) by row, in column order
+    int* rowColumn; // The column of every entry of 'rowEntry'
+    double* b; // The right hand side
+    double* c; // The costs
+    double* u; // The upper bound of every column (INFINITY if it has none)
+    int* column; // The (first) column of every decision variable and then of every slack, -1 if it has none
+    double* sign; // Decision variable j is offset[j] + sign[j] * x[column[j]] (minus x[column[j] + 1] if free)
+    double* offset;
+    char* free; // Set for the free decision variables
+    double* x; // The primal solution
+    double* s; // The distance of every column to its upper bound (unused without one)
+    double* y; // The dual solution of the rows
+    double* z; // The dual solution of the lower bounds
+    double* w; // The dual solution of the upper bounds (0 without one)
+} ipm_problem;
+
+// Get the interior point form of a problem (as for revised_simplex), allocated from 'ctx'.
+ipm_problem ipm_setup(vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb, simplex_context* ctx) {
+
+    ipm_problem f;
+    int n = c->size;
+    f.m = b->size;
+    f.column = (int*)context_alloc(ctx, sizeof(int) * ((size_t)n + f.m));
+    f.sign = (double*)context_alloc(ctx, sizeof(double) * (n > 0 ? n : 1));
+    f.offset = (double*)context_alloc(ctx, sizeof(double) * (n > 0 ? n : 1));
+    f.free = (char*)context_alloc(ctx, n > 0 ? n : 1);
+
+    // Columns of the decision variables and the slacks
+    f.n = 0;
+    for (int j = 0; j < n; j++) {
+        double lower = vb ? vb->lower[j] : 0, upper = vb ? vb->upper[j] : INFINITY;
+        f.free[j] = !isfinite(lower) && !isfinite(upper);
+        f.sign[j] = isfinite(lower) || f.free[j] ? 1 : -1;
+        f.offset[j] = isfinite(lower) ? lower : isfinite(upper) ? upper : 0;
+        f.column[j] = lower == upper ? -1 : f.n;
+        f.n += lower == upper ? 0 : f.free[j] ? 2 : 1;
+    }
+    for (int i = 0; i < f.m; i++)
+        f.column[n + i] = sense && sense[i] == SENSE_EQ ? -1 : f.n++;
+
+    // The constraints, costs, bounds and right hand side (less the offsets)
+    size_t cols = f.n > 0 ? f.n : 1, rows = f.m > 0 ? f.m : 1;
+    f.b = (double*)context_alloc(ctx, sizeof(double) * rows);
+    f.y = (double*)context_alloc(ctx, sizeof(double) * rows);
+    f.c = (double*)context_alloc(ctx, sizeof(double) * cols);
+    f.u = (double*)context_alloc(ctx, sizeof(double) * cols);
+    f.x = (double*)context_alloc(ctx, sizeof(double) * cols);
+    f.s = (double*)context_alloc(ctx, sizeof(double) * cols);
+    f.z = (double*)context_alloc(ctx, sizeof(double) * cols);
+    f.w = (double*)context_alloc(ctx, sizeof(double) * cols);
+    memcpy(f.b, b->data, sizeof(double) * f.m);
+    triplets t = trip(a->nnz + f.m);
+    for (int j = 0; j < n; j++) {
+        int col = f.column[j];
+        for (int k = a->start[j]; k < a->start[j + 1]; k++) {
+            f.b[a->index[k]] -= a->value[k] * f.offset[j];
+            if (col == -1)
+                continue;
+            trip_add(&t, a->index[k], col, f.sign[j] * a->value[k]);
+            if (f.free[j])
+                trip_add(&t, a->index[k], col + 1, -a->value[k]);
+        }
+        if (col == -1)
+            continue;
+        f.c[col] = -f.sign[j] * c->data[j];
+        f.u[col] = vb && isfinite(vb->lower[j]) ? vb->upper[j] - vb->lower[j] : INFINITY;
+        if (f.free[j]) {
+            f.c[col + 1] = c->data[j];
+            f.u[col + 1] = INFINITY;
+        }
+    }
+    for (int i = 0; i < f.m; i++) {
+        int col = f.column[n + i];
+        if (col == -1)
+            continue;
+        trip_add(&t, i, col, 1);
+        f.c[col] = 0;
+        f.u[col] = INFINITY;
+    }
+    f.a = sp_from_triplets(f.m, f.n, &t);
+    freetrip(&t);
+
+    // Sort the columns by row (they are usually sorted already) and merge repeated rows
+    int nnz = 0;
+    for (int j = 0; j < f.n; j++) {
+        int begin = nnz;
+        for (int p = f.a.start[j]; p < f.a.start[j + 1]; p++) {
+            int r = f.a.index[p], q = nnz;
+            double v = f.a.value[p];
+            while (q > begin && f.a.index[q - 1] > r)
+                q--;
+            if (q > begin && f.a.index[q - 1] == r) {
+                f.a.value[q - 1] += v;
+                continue;
+            }
+            memmove(f.a.index + q + 1, f.a.index + q, sizeof(int) * (nnz - q));
+            memmove(f.a.value + q + 1, f.a.value + q, sizeof(double) * (nnz - q));
+            f.a.index[q] = r;
+            f.a.value[q] = v;
+            nnz++;
+        }
+        f.a.start[j] = begin;
+    }
+    f.a.start[f.n] = f.a.nnz = nnz;
+
+    // Index the entries by row
+    f.rowStart = (int*)context_alloc(ctx, sizeof(int) * (rows + 1));
+    f.rowEntry = (int*)context_alloc(ctx, sizeof(int) * (nnz > 0 ? nnz : 1));
+    f.rowColumn = (int*)context_alloc(ctx, sizeof(int) * (nnz > 0 ? nnz : 1));
+    memset(f.rowStart, 0, sizeof(int) * (rows + 1));
+    for (int p = 0; p < nnz; p++)
+        f.rowStart[f.a.index[p] + 1]++;
+    for (int i = 0; i < f.m; i++)
+        f.rowStart[i + 1] += f.rowStart[i];
+    int* next = (int*)malloc(sizeof(int) * rows);
+    memcpy(next, f.rowStart, sizeof(int) * f.m);
+    for (int j = 0; j < f.n; j++)
+        for (int p = f.a.start[j]; p < f.a.start[j + 1]; p++) {
+            f.rowEntry[next[f.a.index[p]]] = p;
+            f.rowColumn[next[f.a.index[p]]++] = j;
+        }
+    free(next);
+    return f;
+
+}
+
+void ipm_free(ipm_problem* f, simplex_context* ctx) {
+    void* buffers[] = { f->column, f->sign, f->offset, f->free, f->rowStart, f->rowEntry, f->rowColumn, f->b, f->y, f->c, f->u, f->x, f->s, f->z, f->w };
+    for (int i = 0; i < (int)(sizeof(buffers) / sizeof(buffers[0])); i++)
+        context_release(ctx, buffers[i]);
+    freesp(&f->a);
+}
+
+// Work shared by the threads forming or factoring a dense normal matrix
+typedef struct {
+    ipm_problem* f; // The problem
+    double* theta; // The weight of every column
+    matrix* l; // The matrix (lower triangle)
+    int k0, k1; // The block column being factored
+} normal_task;
+
+// Pool task: rows [begin, end) of the lower triangle of A diag(theta) A^T. Row i adds theta_j a_ij times the
+// part of column j up to row i for every entry of the row, so the row being summed stays in the cache.
+void normal_rows(void* arg, int block, int begin, int end) {
+    normal_task* t = (normal_task*)arg;
+    (void)block;
+    ipm_problem* f = t->f;
+    for (int i = begin; i < end; i++) {
+        double* row = mat_row(t->l, i);
+        memset(row, 0, sizeof(double) * (i + 1));
+        for (int e = f->rowStart[i]; e < f->rowStart[i + 1]; e++) {
+            int j = f->rowColumn[e], p = f->rowEntry[e];
+            double v = t->theta[j] * f->a.value[p];
+            for (int q = f->a.start[j]; q <= p; q++)
+                row[f->a.index[q]] += v * f->a.value[q];
+        }
+    }
+}
+
+// Pool task: the rows [begin, end) below the diagonal block solve for their entries in block column [k0, k1).
+void cholesky_panel(void* arg, int block, int begin, int end) {
+    normal_task* t = (normal_task*)arg;
+    (void)block;
+    for (int i = t->k1 + begin; i < t->k1 + end; i++) {
+        double* row = mat_row(t->l, i);
+        for (int j = t->k0; j < t->k1; j++) {
+            double* rj = mat_row(t->l, j);
+            double s = row[j];
+            for (int k = t->k0; k < j; k++)
+                s -= row[k] * rj[k];
+            row[j] = s / rj[j];
+        }
+    }
+}
+
+// Pool task: the rows [begin, end) of the trailing matrix subtract the product of their block of the panel
+// with the blocks of the rows above them, four of those at a time to keep four independent sums going.
+void cholesky_update(void* arg, int block, int begin, int end) {
+    normal_task* t = (normal_task*)arg;
+    (void)block;
+    int k0 = t->k0, k1 = t->k1;
+    for (int i = k1 + begin; i < k1 + end; i++) {
+        double* row = mat_row(t->l, i);
+        int j = k1;
+        for (; j + 3 <= i; j += 4) {
+            double *r0 = mat_row(t->l, j), *r1 = mat_row(t->l, j + 1), *r2 = mat_row(t->l, j + 2), *r3 = mat_row(t->l, j + 3);
+            double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            for (int k = k0; k < k1; k++) {
+                s0 += row[k] * r0[k];
+                s1 += row[k] * r1[k];
+                s2 += row[k] * r2[k];
+                s3 += row[k] * r3[k];
+            }
+            row[j] -= s0;
+            row[j + 1] -= s1;
+            row[j + 2] -= s2;
+            row[j + 3] -= s3;
+        }
+        for (; j <= i; j++) {
+            double* rj = mat_row(t->l, j);
+            double s = 0;
+            for (int k = k0; k < k1; k++)
+                s += row[k] * rj[k];
+            row[j] -= s;
+        }
+    }
+}
+
+// Factor the symmetric positive semidefinite matrix in the lower triangle of 'l' into L L^T in place, one
+// block column of CHOLESKY_BLOCK columns at a time: factor the diagonal block, solve the rows below it for
+// the panel and subtract the panel from the trailing matrix (the last two split over the pool). A pivot
+// that cancels to almost nothing belongs to a dependent row and is replaced by a huge value, which drops
+// the row from the solves. 'diag' is scratch space for the diagonal.
+// Returns the amount of dropped rows.
+int cholesky(matrix* l, double* diag) {
+    normal_task t;
+    t.l = l;
+    int m = l->rows, dropped = 0;
+    for (int i = 0; i < m; i++)
+        diag[i] = mat_row(l, i)[i];
+    for (t.k0 = 0; t.k0 < m; t.k0 = t.k1) {
+        t.k1 = t.k0 + CHOLESKY_BLOCK < m ? t.k0 + CHOLESKY_BLOCK : m;
+        for (int i = t.k0; i < t.k1; i++) {
+            double* row = mat_row(l, i);
+            for (int j = t.k0; j <= i; j++) {
+                double* rj = mat_row(l, j);
+                double s = row[j];
+                for (int k = t.k0; k < j; k++)
+                    s -= row[k] * rj[k];
+                if (j < i) {
+                    row[j] = s / rj[j];
+                } else if (s > CHOLESKY_TINY * diag[i]) {
+                    row[i] = sqrt(s);
+                } else {
+                    row[i] = 1e64;
+                    dropped++;
+                }
+            }
+        }
+        long rest = m - t.k1;
+        pool_run(cholesky_panel, &t, (int)rest, rest * CHOLESKY_BLOCK);
+        pool_run(cholesky_update, &t, (int)rest, rest * rest);
+    }
+    return dropped;
+}
+
+// Solve L L^T v' = v in place with the factor from cholesky.
+void cholesky_solve(matrix* l, double* v) {
+    for (int i = 0; i < l->rows; i++) {
+        double* row = mat_row(l, i);
+        double s = v[i];
+        for (int k = 0; k < i; k++)
+            s -= row[k] * v[k];
+        v[i] = s / row[i];
+    }
+    for (int i = l->rows - 1; i >= 0; i--) {
+        double* row = mat_row(l, i);
+        v[i] /= row[i];
+        if (v[i] != 0)
+            for (int k = 0; k < i; k++)
+                v[k] -= row[k] * v[i];
+    }
+}
+
+// Factor the normal matrix A diag(theta) A^T into 'l'.
+void ipm_factor(ipm_problem* f, double* theta, matrix* l, double* diag) {
+    normal_task t;
+    t.f = f;
+    t.theta = theta;
+    t.l = l;
+    pool_run(normal_rows, &t, f->m, (long)f->m * f->m);
+    cholesky(l, diag);
+}
+
+// The residuals and scratch space of the interior point method
+typedef struct {
+    double* rp; // b - Ax
+    double* rd; // c - A^T y - z + w
+    double* ru; // u - x - s
+    double* rxz; // The right hand side of the complementarity of x and z
+    double* rsw; // The right hand side of the complementarity of s and w
+    double* theta; // 1 / (z / x + w / s), the weights of the normal matrix
+    double* diag; // Scratch space of cholesky
+    double* d[5]; // The direction (x, y, z, s, w)
+    double* a[5]; // The predictor direction (x, y, z, s, w)
+} ipm_work;
+
+// Solve the Newton system for the residuals in 'k' and the right hand sides k->rxz and k->rsw, with the
+// normal matrix factored into 'l', for the direction 'd' (x, y, z, s, w). With g = rd - rxz / x +
+// (rsw - w ru) / s, the rows follow from A theta A^T dy = rp + A theta g and the rest from dy.
+void ipm_direction(ipm_problem* f, ipm_work* k, matrix* l, double** d) {
+    double *dx = d[0], *dy = d[1], *dz = d[2], *ds = d[3], *dw = d[4];
+    for (int j = 0; j < f->n; j++) {
+        double g = k->rd[j] - k->rxz[j] / f->x[j];
+        if (f->u[j] < INFINITY)
+            g += (k->rsw[j] - f->w[j] * k->ru[j]) / f->s[j];
+        dx[j] = k->theta[j] * g;
+    }
+    memcpy(dy, k->rp, sizeof(double) * f->m);
+    for (int j = 0; j < f->n; j++)
+        for (int p = f->a.start[j]; p < f->a.start[j + 1]; p++)
+            dy[f->a.index[p]] += f->a.value[p] * dx[j];
+    cholesky_solve(l, dy);
+    for (int j = 0; j < f->n; j++) {
+        double s = 0;
+        for (int p = f->a.start[j]; p < f->a.start[j + 1]; p++)
+            s += f->a.value[p] * dy[f->a.index[p]];
+        dx[j] = k->theta[j] * s - dx[j];
+        dz[j] = (k->rxz[j] - f->z[j] * dx[j]) / f->x[j];
+        ds[j] = dw[j] = 0;
+        if (f->u[j] < INFINITY) {
+            ds[j] = k->ru[j] - dx[j];
+            dw[j] = (k->rsw[j] - f->w[j] * ds[j]) / f->s[j];
+        }
+    }
+}
+
+// Get the longest step (at most 1) along 'dv' that keeps the bounded entries (all if 'u' is 0) of 'v' positive.
+double ipm_step(ipm_problem* f, double* v, double* dv, double* u) {
+    double step = 1;
+    for (int j = 0; j < f->n; j++)
+        if (dv[j] < 0 && (!u || u[j] < INFINITY) && -v[j] / dv[j] < step)
+            step = -v[j] / dv[j];
+    return step;
+}
+
+// Get the largest absolute value of 'v'.
+double norm_inf(double* v, int n) {
+    double m = 0;
+    for (int i = 0; i < n; i++)
+        m = fabs(v[i]) > m ? fabs(v[i]) : m;
+    return m;
+}
+
+// Set the starting point of the interior point method (Mehrotra's): the least squares solutions of Ax = b
+// and A^T y = c, with x and the dual slacks shifted to be positive and then balanced against each other.
+// 'l' holds the factor of A A^T.
+void ipm_start(ipm_problem* f, ipm_work* k, matrix* l) {
+
+    double* t = k->rp;
+    int n = f->n;
+    memcpy(t, f->b, sizeof(double) * f->m);
+    cholesky_solve(l, t);
+    memset(f->y, 0, sizeof(double) * f->m);
+    for (int j = 0; j < n; j++)
+        for (int p = f->a.start[j]; p < f->a.start[j + 1]; p++)
+            f->y[f->a.index[p]] += f->a.value[p] * f->c[j];
+    cholesky_solve(l, f->y);
+    double minX = INFINITY, minZ = INFINITY;
+    for (int j = 0; j < n; j++) {
+        double x = 0, r = f->c[j];
+        for (int p = f->a.start[j]; p < f->a.start[j + 1]; p++) {
+            x += f->a.value[p] * t[f->a.index[p]];
+            r -= f->a.value[p] * f->y[f->a.index[p]];
+        }
+        f->x[j] = x;
+        f->z[j] = r;
+        if (f->u[j] == INFINITY) {
+            minX = x < minX ? x : minX;
+            minZ = r < minZ ? r : minZ;
+        }
+    }
+
+    // Shift the columns without an upper bound into the positive orthant, and put the others inside
+    // their box with their reduced cost split over z and w
+    double shiftX = minX < 0 ? -1.5 * minX : 0, shiftZ = minZ < 0 ? -1.5 * minZ : 0;
+    double xz = 0, sumX = 0, sumZ = 0;
+    for (int j = 0; j < n; j++) {
+        if (f->u[j] == INFINITY) {
+            f->x[j] += shiftX;
+            f->z[j] += shiftZ;
+            f->w[j] = f->s[j] = 0;
+        } else {
+            double x = f->x[j] + shiftX, r = f->z[j];
+            f->x[j] = x < 0.1 * f->u[j] ? 0.1 * f->u[j] : x > 0.9 * f->u[j] ? 0.9 * f->u[j] : x;
+            f->s[j] = f->u[j] - f->x[j];
+            f->z[j] = (r > 0 ? r : 0) + shiftZ;
+            f->w[j] = (r < 0 ? -r : 0) + shiftZ;
+            xz += f->s[j] * f->w[j];
+            sumX += f->s[j];
+            sumZ += f->w[j];
+        }
+        xz += f->x[j] * f->z[j];
+        sumX += f->x[j];
+        sumZ += f->z[j];
+    }
+    double balanceX = sumZ > 0 ? 0.5 * xz / sumZ : 0, balanceZ = sumX > 0 ? 0.5 * xz / sumX : 0;
+    for (int j = 0; j < n; j++) {
+        if (f->u[j] == INFINITY)
+            f->x[j] += balanceX;
+        f->z[j] += balanceZ;
+        if (!(f->x[j] > 0))
+            f->x[j] = 1;
+        if (!(f->z[j] > 0))
+            f->z[j] = 1;
+        if (f->u[j] < INFINITY) {
+            f->w[j] += balanceZ;
+            if (!(f->w[j] > 0))
+                f->w[j] = 1;
+        }
+    }
+
+}
+
+// Solve the problem with Mehrotra's predictor-corrector method until the relative primal and dual
+// infeasibility and the duality gap are below IPM_EPS. Every step factors the normal matrix once, takes
+// the affine scaling (predictor) direction to pick the centering, and solves again for the corrector.
+// 'objective' is the constant the objective of the original problem has on top of -c'x.
+// Returns the amount of steps, or -1 if the method stalled or diverged (for an infeasible or unbounded
+// problem, or too much numerical trouble).
+int ipm_solve(ipm_problem* f, double objective, simplex_context* ctx, writer* out) {
+
+    // Work space
+    size_t cols = sizeof(double) * (f->n > 0 ? f->n : 1), rows = sizeof(double) * (f->m > 0 ? f->m : 1);
+    ipm_work k;
+    k.rp = (double*)context_alloc(ctx, rows);
+    k.diag = (double*)context_alloc(ctx, rows);
+    k.rd = (double*)context_alloc(ctx, cols);
+    k.ru = (double*)context_alloc(ctx, cols);
+    k.rxz = (double*)context_alloc(ctx, cols);
+    k.rsw = (double*)context_alloc(ctx, cols);
+    k.theta = (double*)context_alloc(ctx, cols);
+    for (int i = 0; i < 5; i++) {
+        k.d[i] = (double*)context_alloc(ctx, i == 1 ? rows : cols);
+        k.a[i] = (double*)context_alloc(ctx, i == 1 ? rows : cols);
+    }
+    matrix l = mat_in(ctx, f->m, f->m);
+    STATS_PEAK(sizeof(double) * (size_t)l.stride * l.rows);
+
+    // Starting point from the factor of A A^T
+    for (int j = 0; j < f->n; j++)
+        k.theta[j] = 1;
+    ipm_factor(f, k.theta, &l, k.diag);
+    ipm_start(f, &k, &l);
+
+    double normB = norm_inf(f->b, f->m), normC = norm_inf(f->c, f->n);
+    for (int j = 0; j < f->n; j++)
+        if (f->u[j] < INFINITY && f->u[j] > normB)
+            normB = f->u[j];
+    int pairs = 0;
+    for (int j = 0; j < f->n; j++)
+        pairs += f->u[j] < INFINITY ? 2 : 1;
+    int steps = 0, stalls = 0, result = -1;
+    double best = INFINITY;
+    for (;;) {
+
+        // Residuals, objectives and the complementarity gap
+        memcpy(k.rp, f->b, sizeof(double) * f->m);
+        double primal = 0, dual = 0, mu = 0, rd = 0, ru = 0;
+        for (int j = 0; j < f->n; j++) {
+            double r = f->c[j] - f->z[j] + f->w[j];
+            for (int p = f->a.start[j]; p < f->a.start[j + 1]; p++) {
+                k.rp[f->a.index[p]] -= f->a.value[p] * f->x[j];
+                r -= f->a.value[p] * f->y[f->a.index[p]];
+            }
+            k.rd[j] = r;
+            rd = fabs(r) > rd ? fabs(r) : rd;
+            primal += f->c[j] * f->x[j];
+            mu += f->x[j] * f->z[j];
+            k.ru[j] = 0;
+            if (f->u[j] < INFINITY) {
+                k.ru[j] = f->u[j] - f->x[j] - f->s[j];
+                ru = fabs(k.ru[j]) > ru ? fabs(k.ru[j]) : ru;
+                dual -= f->u[j] * f->w[j];
+                mu += f->s[j] * f->w[j];
+            }
+        }
+        for (int i = 0; i < f->m; i++)
+            dual += f->b[i] * f->y[i];
+        mu /= pairs > 0 ? pairs : 1;
+        double rp = norm_inf(k.rp, f->m);
+        double pinf = (rp > ru ? rp : ru) / (1 + normB), dinf = rd / (1 + normC);
+        double gap = fabs(primal - dual) / (1 + fabs(primal));
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, "Barrier step %i: objective %.6f, primal infeasibility %.2e, dual infeasibility %.2e, gap %.2e\n",
+                steps, objective - primal, pinf, dinf, gap);
+        if (pinf < IPM_EPS && dinf < IPM_EPS && gap < IPM_EPS) {
+            result = steps;
+            break;
+        }
+        double worst = pinf > dinf ? pinf : dinf;
+        worst = gap > worst ? gap : worst;
+        stalls = worst < 0.9 * best ? 0 : stalls + 1;
+        best = worst < best ? worst : best;
+        if (steps == IPM_MAX_STEPS || stalls == IPM_STALL || !isfinite(mu) || norm_inf(f->x, f->n) > 1e30 || norm_inf(f->y, f->m) > 1e30)
+            break;
+
+        // Factor the normal matrix of the current point
+        for (int j = 0; j < f->n; j++)
+            k.theta[j] = 1 / (f->z[j] / f->x[j] + (f->u[j] < INFINITY ? f->w[j] / f->s[j] : 0));
+        ipm_factor(f, k.theta, &l, k.diag);
+
+        // Predictor: the affine scaling direction, and how far it gets the complementarity gap
+        for (int j = 0; j < f->n; j++) {
+            k.rxz[j] = -f->x[j] * f->z[j];
+            k.rsw[j] = f->u[j] < INFINITY ? -f->s[j] * f->w[j] : 0;
+        }
+        ipm_direction(f, &k, &l, k.a);
+        double stepP = ipm_step(f, f->x, k.a[0], 0), stepD = ipm_step(f, f->z, k.a[2], 0);
+        double stepS = ipm_step(f, f->s, k.a[3], f->u), stepW = ipm_step(f, f->w, k.a[4], f->u);
+        stepP = stepS < stepP ? stepS : stepP;
+        stepD = stepW < stepD ? stepW : stepD;
+        double affine = 0;
+        for (int j = 0; j < f->n; j++) {
+            affine += (f->x[j] + stepP * k.a[0][j]) * (f->z[j] + stepD * k.a[2][j]);
+            if (f->u[j] < INFINITY)
+                affine += (f->s[j] + stepP * k.a[3][j]) * (f->w[j] + stepD * k.a[4][j]);
+        }
+        affine /= pairs;
+        double sigma = mu > 0 ? pow(affine / mu, 3) : 0;
+        sigma = sigma < 1 ? sigma : 1;
+
+        // Corrector: aim at the centered point of sigma mu, with the second order term of the predictor
+        for (int j = 0; j < f->n; j++) {
+            k.rxz[j] = sigma * mu - f->x[j] * f->z[j] - k.a[0][j] * k.a[2][j];
+            k.rsw[j] = f->u[j] < INFINITY ? sigma * mu - f->s[j] * f->w[j] - k.a[3][j] * k.a[4][j] : 0;
+        }
+        ipm_direction(f, &k, &l, k.d);
+        stepP = ipm_step(f, f->x, k.d[0], 0);
+        stepD = ipm_step(f, f->z, k.d[2], 0);
+        stepS = ipm_step(f, f->s, k.d[3], f->u);
+        stepW = ipm_step(f, f->w, k.d[4], f->u);
+        stepP = IPM_STEP * (stepS < stepP ? stepS : stepP);
+        stepD = IPM_STEP * (stepW < stepD ? stepW : stepD);
+        stepP = stepP < 1 ? stepP : 1;
+        stepD = stepD < 1 ? stepD : 1;
+
+        // Take the step
+        for (int j = 0; j < f->n; j++) {
+            f->x[j] += stepP * k.d[0][j];
+            f->z[j] += stepD * k.d[2][j];
+            if (f->u[j] < INFINITY) {
+                f->s[j] += stepP * k.d[3][j];
+                f->w[j] += stepD * k.d[4][j];
+            }
+        }
+        for (int i = 0; i < f->m; i++)
+            f->y[i] += stepD * k.d[1][i];
+        steps++;
+        STATS_ADD(steps, 1);
+
+    }
+
+    // Cleanup
+    context_release(ctx, l.data);
+    void* buffers[] = { k.rp, k.diag, k.rd, k.ru, k.rxz, k.rsw, k.theta, k.d[0], k.d[1], k.d[2], k.d[3], k.d[4],
+                        k.a[0], k.a[1], k.a[2], k.a[3], k.a[4] };
+    for (int i = 0; i < (int)(sizeof(buffers) / sizeof(buffers[0])); i++)
+        context_release(ctx, buffers[i]);
+    return result;
+
+}
+
+// A candidate for the crossover basis: a variable (as in dictionary.vars) and how clearly it is away from its bounds
+typedef struct {
+    double score;
+    int var;
+} crossover_candidate;
+
+int compare_candidates(const void* a, const void* b) {
+    const crossover_candidate* x = (const crossover_candidate*)a;
+    const crossover_candidate* y = (const crossover_candidate*)b;
+    if (x->score != y->score)
+        return x->score > y->score ? -1 : 1;
+    return x->var - y->var;
+}
+
+// Pick the starting basis of the crossover from the interior solution of 'f' (the form of a problem with
+// constraints 'a'): the variables in order of how clearly they are away from their bounds (x / (x + z),
+// the smaller one towards the upper bound if there is one; free variables first and the slacks of equality
+// rows last), each taken if its column of [A I] is independent of the ones taken so far. The columns are
+// reduced against the taken ones by Gaussian elimination. Nonbasic variables closer to their upper bound
+// get their entry of 'upper' set. The variables of the basis are allocated from 'ctx'.
+basis ipm_basis(ipm_problem* f, spmatrix* a, char* upper, simplex_context* ctx) {
+
+    // Rank the variables
+    int n = a->columns, m = f->m;
+    crossover_candidate* order = (crossover_candidate*)context_alloc(ctx, sizeof(crossover_candidate) * ((size_t)n + m + 1));
+    for (int v = 1; v <= n + m; v++) {
+        int j = v - 1, col = f->column[j];
+        double score = -1;
+        if (j < n)
+            upper[j] = 0;
+        if (col != -1 && j < n && f->free[j]) {
+            score = 2;
+        } else if (col != -1) {
+            score = f->x[col] / (f->x[col] + f->z[col]);
+            if (f->u[col] < INFINITY) {
+                double room = f->s[col] / (f->s[col] + f->w[col]);
+                upper[j] = room < score && f->sign[j] > 0;
+                score = room < score ? room : score;
+            }
+        }
+        order[v - 1].score = score;
+        order[v - 1].var = v;
+    }
+    qsort(order, (size_t)n + m, sizeof(crossover_candidate), compare_candidates);
+
+    // Take independent columns until there is one per row
+    basis s;
+    s.varc = n;
+    s.rows = m;
+    s.vars = (int*)context_alloc(ctx, sizeof(int) * ((size_t)n + m + 1));
+    matrix kept = mat_in(ctx, m, m);
+    int* pivot = (int*)context_alloc(ctx, sizeof(int) * (m > 0 ? m : 1));
+    char* taken = (char*)context_alloc(ctx, (size_t)n + m + 1);
+    memset(taken, 0, (size_t)n + m + 1);
+    int k = 0;
+    for (int c = 0; c < n + m && k < m; c++) {
+        int v = order[c].var;
+        double* col = mat_row(&kept, k);
+        memset(col, 0, sizeof(double) * m);
+        if (v <= n)
+            for (int p = a->start[v - 1]; p < a->start[v]; p++)
+                col[a->index[p]] += a->value[p];
+        else
+            col[v - n - 1] = 1;
+        double size = norm_inf(col, m);
+        for (int t = 0; t < k && size > 0; t++) {
+            double* prev = mat_row(&kept, t);
+            if (col[pivot[t]] != 0)
+                row_update(col, prev, -col[pivot[t]] / prev[pivot[t]], m);
+        }
+        int p = 0;
+        for (int i = 1; i < m; i++)
+            if (fabs(col[i]) > fabs(col[p]))
+                p = i;
+        if (size == 0 || fabs(col[p]) <= 1e-9 * size)
+            continue;
+        pivot[k] = p;
+        s.vars[n + k++] = v;
+        taken[v] = 1;
+    }
+    for (int v = 1, j = 0; v <= n + m; v++)
+        if (!taken[v] && j < n)
+            s.vars[j++] = v;
+
+    context_release(ctx, order);
+    context_release(ctx, taken);
+    context_release(ctx, kept.data);
+    context_release(ctx, pivot);
+    return s;
+
+}
+
+// Solve the problem (as for revised_simplex) with the interior point method, then cross over to an
+// optimal basis: the revised simplex method starts from the basis picked from the interior solution
+// (see ipm_basis), which is usually optimal or a few pivots away. If the interior point method does not
+// converge (which is what happens to infeasible and unbounded problems), the revised simplex method solves
+// the problem from scratch and tells which one it is.
+dictionary interior_point(vector* c, vector* b, spmatrix* a, signed char* sense, var_bounds* vb, simplex_context* ctx, writer* out) {
+
+    STATS_CLOCK(start);
+    ipm_problem f = ipm_setup(c, b, a, sense, vb, ctx);
+    double objective = 0;
+    for (int j = 0; j < c->size; j++)
+        objective += c->data[j] * f.offset[j];
+    int log = out->level >= VERBOSITY_NORMAL;
+    if (log)
+        wr_printf(out, "--- Interior Point Method (%i rows, %i columns) ---\n", f.m, f.n);
+    int steps = ipm_solve(&f, objective, ctx, out);
+    STATS_TIME(barrier, start);
+
+    // Cross over to a basis, or solve with the simplex method
+    dictionary d;
+    if (steps >= 0) {
+        char* upper = (char*)context_alloc(ctx, c->size > 0 ? c->size : 1);
+        basis s = ipm_basis(&f, a, upper, ctx);
+        if (log)
+            wr_printf(out, "--- Interior Point Method Converged in %i Steps, Crossover ---\n", steps);
+        d = revised_solve(c, b, a, sense, vb, &s, upper, ctx, out);
+        context_release(ctx, s.vars);
+        context_release(ctx, upper);
+    } else {
+        if (log)
+            wr_printf(out, "--- Interior Point Method Did Not Converge, Solving with the Simplex Method ---\n");
+        d = revised_solve(c, b, a, sense, vb, 0, 0, ctx, out);
+    }
+    ipm_free(&f, ctx);
+    return d;
+
+}
+
+// Get the value of variable 'v' of a solved dictionary at x (the value of its row, or 0 if it is nonbasic),
+// in terms of the problem before scaling.
+double solution_value(dictionary* d, int v, double x) {
+    return var_value(d, v, x) * (d->scale ? d->scale->unscale[v] : 1);
+}
+
+// Get the value of every variable of the problem before presolve (by variable, x must hold its columns
+// plus its rows plus one) from a solved dictionary of the reduced problem: the columns it kept, the removed
+// columns from the postsolve stack, and the slack of every row from the original constraints.
+void postsolve_values(dictionary* d, double* x) {
+    postsolve* post = d->post;
+    memset(x, 0, sizeof(double) * (post->columns + post->rows + 1));
+    for (int j = 0; j < d->varc && d->forms; j++) {
+        int v = d->vars[j];
+        if (v <= d->varc)
+            x[post->columnMap[v - 1] + 1] = solution_value(d, v, 0);
+    }
+    for (int i = 1; i < d->dic.rows; i++) {
+        int v = d->vars[d->varc - 1 + i];
+        if (v <= d->varc)
+            x[post->columnMap[v - 1] + 1] = solution_value(d, v, mat_row(&d->dic, i)[0]);
+    }
+    for (int k = post->count - 1; k >= 0; k--)
+        x[post->stack[k].column + 1] = post->stack[k].value;
+    double* w = x + post->columns + 1;
+    memcpy(w, post->b, sizeof(double) * post->rows);
+    for (int j = 0; j < post->columns; j++)
+        for (int k = post->a->start[j]; k < post->a->start[j + 1]; k++)
+            w[post->a->index[k]] -= post->a->value[k] * x[j + 1];
+}
+
+// Get the name of variable 'v' of a solved dictionary, in terms of the problem before presolve.
+void solution_name(dictionary* dic, char* n, int v) {
+    postsolve* post = dic->post;
+    if (!post)
+        get_var(dic, n, v);
+    else if (v <= dic->varc)
+        var_name(post->columns, n, post->columnMap[v - 1] + 1);
+    else
+        var_name(post->columns, n, post->columns + 1 + post->rowMap[v - dic->varc - 1]);
+}
+
+// Print solution
+void print_solution(dictionary* dic) {
+
+    // Only print if success
+    if (dic->state == SIMPLEX_STATE_SUCCESS) {
+        postsolve* post = dic->post;
+        wr_printf(dic->out, "Maximum Value: %f\nVariables: ", mat_row(&dic->dic, 0)[0] + (post ? post->offset : 0));
+        int printed = 0;
+        for (int i = 1; i < dic->dic.rows; i++) {
+            char n[VAR_NAME_SIZE];
+            int v = dic->vars[dic->varc - 1 + i];
+            solution_name(dic, n, v);
+            wr_printf(dic->out, "%s%s = %.4f", i > 1 ? ", " : "", n, solution_value(dic, v, mat_row(&dic->dic, i)[0]));
+            printed++;
+        }
+
+        // With bounds, nonbasic decision variables can be away from zero
+        for (int j = 0; j < dic->varc && dic->forms; j++) {
+            char n[VAR_NAME_SIZE];
+            int v = dic->vars[j];
+            if (v > dic->varc || dic->forms[v].offset == 0)
+                continue;
+            solution_name(dic, n, v);
+            wr_printf(dic->out, "%s%s = %.4f", printed++ ? ", " : "", n, solution_value(dic, v, 0));
+        }
+
+        // Columns removed by presolve, from the postsolve stack, and the slacks of removed rows
+        if (post) {
+            double* x = (double*)malloc(sizeof(double) * ((size_t)post->columns + post->rows + 1));
+            postsolve_values(dic, x);
+            for (int k = post->count - 1; k >= 0; k--) {
+                char n[VAR_NAME_SIZE];
+                if (post->stack[k].value == 0)
+                    continue;
+                var_name(post->columns, n, post->stack[k].column + 1);
+                wr_printf(dic->out, "%s%s = %.4f", printed++ ? ", " : "", n, post->stack[k].value);
+            }
+            for (int i = 0, q = 0; i < post->rows; i++) {
+                char n[VAR_NAME_SIZE];
+                double w = x[post->columns + 1 + i];
+                if (q < post->keptRows && post->rowMap[q] == i) {
+                    q++; // Kept rows are printed with the basis
+                    continue;
+                }
+                if (fabs(w) <= PRESOLVE_EPS * (1 + fabs(post->b[i])))
+                    continue;
+                var_name(post->columns, n, post->columns + 1 + i);
+                wr_printf(dic->out, "%s%s = %.4f", printed++ ? ", " : "", n, w);
+            }
+            free(x);
+        }
+    } else if (dic->state == SIMPLEX_STATE_INFEASIBLE) {
+        wr_printf(dic->out, "Problem is infeasible and has no solution");
+    } else if (dic->state == SIMPLEX_STATE_UNBOUNDED) {
+        wr_printf(dic->out, "Problem is unbounded and thus has no optimal solution");
+    } else if (dic->state == SIMPLEX_STATE_ITERATION_LIMIT) {
+        wr_printf(dic->out, "Iteration limit reached before the problem was solved");
+    }
+    wr_printf(dic->out, "\n\n");
+
+}
+
+// A problem file in memory and a cursor into it
+typedef struct {
+    const char* path; // The file path (for error messages)
+    const char* data; // The file contents
+    size_t size; // The size of the contents
+    size_t pos; // The position of the cursor
+    int line; // The line of the cursor (1-based)
+    size_t lineStart; // The position where the line of the cursor starts
+    int mapped; // Set if the contents are memory mapped rather than allocated
+} source;
+
+// Variants of a problem that replace some of its bounds or objective coefficients, solved on the same
+// constraint matrix after the problem itself
+typedef struct {
+    int count; // The amount of scenarios
+    char* objective; // Set if scenario k replaces objective coefficients, otherwise it replaces bounds
+    int* start; // The entries of scenario k are start[k] up to start[k + 1]
+    int* index; // The row (or variable) of every entry, 0-based
+    double* value; // The value of every entry
+} scenario_set;
+
+typedef struct {
+    int vars;
+    char max;
+    vector c; // Coefficients
+    vector b; // Bounds
+    spmatrix a; // Constraints
+    signed char* sense; // The type of every constraint as read (SENSE_LE, SENSE_EQ or SENSE_GE)
+    double* lower; // The lower bound of every variable, or 0 if all variables are non-negative
+    double* upper; // The upper bound of every variable, or 0 if all variables are non-negative
+    source file; // The file the arrays point into (binary files), or no data
+    scenario_set scen; // Other bounds or objectives to solve the problem with (count 0 if none)
+} linprog;
+
+// Load a file into memory, memory mapping it where possible ("-" reads stdin).
+// Returns 0 if the file could not be read.
+int src_open(source* src, const char* path) {
+
+    src->path = path;
+    src->data = 0;
+    src->size = 0;
+    src->pos = 0;
+    src->line = 1;
+    src->lineStart = 0;
+    src->mapped = 0;
+
+#ifdef SIMPLEX_MMAP
+    if (strcmp(path, "-") != 0) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return 0;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                close(fd);
+                src->data = (const char*)p;
+                src->size = (size_t)st.st_size;
+                src->mapped = 1;
+                return 1;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    // Read the stream in large chunks
+    FILE* pFile = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!pFile)
+        return 0;
+    size_t cap = 1 << 20;
+    char* buffer = (char*)malloc(cap);
+    size_t n;
+    while ((n = fread(buffer + src->size, 1, cap - src->size, pFile)) > 0) {
+        src->size += n;
+        if (src->size == cap) {
+            grow_array((void**)&buffer, 1, cap * 2);
+            cap *= 2;
+        }
+    }
+    if (pFile != stdin)
+        fclose(pFile);
+    src->data = buffer;
+    return 1;
+
+}
+
+void src_close(source* src) {
+#ifdef SIMPLEX_MMAP
+    if (src->mapped) {
+        munmap((void*)src->data, src->size);
+        return;
+    }
+#endif
+    free((void*)src->data);
+}
+
+// Report an error at the start of the token 'tok' (or at the cursor if 'tok' is 0).
+void src_error(source* src, const char* tok, const char* format, ...) {
+    size_t at = tok ? (size_t)(tok - src->data) : src->pos;
+    fprintf(stderr, "%s:%i:%i: ", src->path, src->line, (int)(at - src->lineStart) + 1);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+// Get the next whitespace separated token, returns 0 at the end of the file.
+int src_token(source* src, const char** tok, size_t* len) {
+    while (src->pos < src->size) {
+        char c = src->data[src->pos];
+        if (c == '\n') {
+            src->line++;
+            src->lineStart = src->pos + 1;
+        } else if (c != ' ' && c != '\t' && c != '\r') {
+            break;
+        }
+        src->pos++;
+    }
+    if (src->pos == src->size)
+        return 0;
+    size_t start = src->pos;
+    while (src->pos < src->size) {
+        char c = src->data[src->pos];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            break;
+        src->pos++;
+    }
+    *tok = src->data + start;
+    *len = src->pos - start;
+    return 1;
+}
+
+// Check if a token equals 'word'.
+int tok_is(const char* tok, size_t len, const char* word) {
+    return strlen(word) == len && memcmp(tok, word, len) == 0;
+}
+
+// Parse a finite decimal number spanning exactly [p, end), returns 0 if it is not a valid number.
+// Plain decimals with up to 19 significant digits and small exponents are converted exactly without strtod.
+int parse_double(const char* p, const char* end, double* out) {
+
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* start = p;
+
+    // Sign, digits, fraction and exponent
+    int neg = 0;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+    unsigned long long mantissa = 0;
+    int digits = 0, exp10 = 0, any = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, any = 1) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exp10++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = 1) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exp10--;
+            }
+        }
+    }
+    if (any && p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int eneg = 0, e = 0, edigits = 0;
+        if (p < end && (*p == '-' || *p == '+'))
+            eneg = *p++ == '-';
+        for (; p < end && *p >= '0' && *p <= '9'; p++, edigits++)
+            e = e < 10000 ? e * 10 + (*p - '0') : e;
+        if (edigits == 0)
+            any = 0;
+        exp10 += eneg ? -e : e;
+    }
+
+    // Exact fast path: the mantissa and the power of ten are both exact doubles
+    if (any && p == end && mantissa < (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+        double v = (double)mantissa;
+        v = exp10 < 0 ? v / pow10[-exp10] : v * pow10[exp10];
+        *out = neg ? -v : v;
+        return 1;
+    }
+
+    // Other decimals (long mantissas, large exponents) go through strtod. Anything strtod takes beyond
+    // them (inf, nan, hex floats) is rejected, as are values that overflow to infinity.
+    char buffer[128];
+    size_t len = (size_t)(end - start);
+    if (!any || p != end || len >= sizeof(buffer))
+        return 0;
+    memcpy(buffer, start, len);
+    buffer[len] = '\0';
+    char* stop;
+    *out = strtod(buffer, &stop);
+    return *stop == '\0' && isfinite(*out);
+
+}
+
+// Parse a variable bound spanning exactly [p, end): a number, or 'inf' or '-inf' for a missing bound.
+int parse_bound(const char* p, const char* end, double* out) {
+    const char* q = p < end && (*p == '-' || *p == '+') ? p + 1 : p;
+    if (end - q == 3 && memcmp(q, "inf", 3) == 0) {
+        *out = *p == '-' ? -INFINITY : INFINITY;
+        return 1;
+    }
+    return parse_double(p, end, out);
+}
+
+// Parse a non-negative integer spanning exactly [p, end).
+int parse_int(const char* p, const char* end, int* out) {
+    long long v = 0;
+    if (p == end)
+        return 0;
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9' || v > INT_MAX)
+            return 0;
+        v = v * 10 + (*p - '0');
+    }
+    if (v > INT_MAX)
+        return 0;
+    *out = (int)v;
+    return 1;
+}
+
+// Parse a coefficient token, either a plain value for position '*pos' or an 'index:value' pair (1-based index).
+// Sets '*sparse' if the token is a pair and returns 0 if the token is not a valid coefficient.
+int read_coefficient(const char* tok, size_t len, int vars, int* pos, int* col, double* val, int* sparse) {
+    const char* end = tok + len;
+    const char* sep = (const char*)memchr(tok, ':', len);
+    if (sep) {
+        int index;
+        if (!parse_int(tok, sep, &index) || index < 1 || index > vars)
+            return 0;
+        *col = index - 1;
+        *sparse = 1;
+        return parse_double(sep + 1, end, val);
+    }
+    if (*pos >= vars)
+        return 0;
+    *col = (*pos)++;
+    *sparse = 0;
+    return parse_double(tok, end, val);
+}
+
+// Read the scenarios section that follows the 'scenarios' keyword: 'scenarios K' followed by K scenarios,
+// each 'rhs' or 'objective' and then either a value for every row (or variable) or 'index:value' pairs
+// (1-based) for the values it replaces. Returns 0 after reporting an error.
+int read_scenarios(source* src, linprog* prog, int constraints) {
+
+    const char* tok = 0;
+    size_t len = 0;
+    int count;
+    if (!src_token(src, &tok, &len) || !parse_int(tok, tok + len, &count) || count < 0) {
+        src_error(src, 0, "Failed to read scenario count.");
+        return 0;
+    }
+    if (count == 0)
+        return 1;
+
+    // The entries of scenario k are kept as triplets of row k, which start from a small guess and grow
+    scenario_set* s = &prog->scen;
+    s->objective = (char*)malloc((size_t)count);
+    s->start = (int*)malloc(sizeof(int) * ((size_t)count + 1));
+    if (!s->objective || !s->start) {
+        free(s->objective);
+        free(s->start);
+        src_error(src, 0, "Out of memory for %i scenarios.", count);
+        return 0;
+    }
+    size_t guess = (size_t)count * 4 + 16;
+    triplets t = trip(guess < 4096 ? (int)guess : 4096);
+    int ok = 1;
+    for (int k = 0; k < count && ok; k++) {
+        s->start[k] = t.nnz;
+        len = 0;
+        if (!src_token(src, &tok, &len) || !(tok_is(tok, len, "rhs") || tok_is(tok, len, "objective"))) {
+            src_error(src, len ? tok : 0, "'rhs' or 'objective' expected in scenario %i.", k + 1);
+            ok = 0;
+            break;
+        }
+        s->objective[k] = tok_is(tok, len, "objective");
+        int size = s->objective[k] ? prog->vars : constraints;
+
+        // Values up to the next keyword
+        int pos = 0, pairs = 0, col, sparse;
+        double val;
+        for (;;) {
+            source mark = *src;
+            if (!src_token(src, &tok, &len))
+                break;
+            if (tok_is(tok, len, "rhs") || tok_is(tok, len, "objective") || tok_is(tok, len, "bounds") || tok_is(tok, len, "scenarios")) {
+                *src = mark;
+                break;
+            }
+            if (!read_coefficient(tok, len, size, &pos, &col, &val, &sparse) || (sparse ? pos > 0 : pairs > 0)) {
+                src_error(src, tok, "Failed to read value '%.*s' of scenario %i.", (int)len, tok, k + 1);
+                ok = 0;
+                break;
+            }
+            pairs += sparse;
+            trip_add(&t, k, col, val);
+        }
+        if (ok && pairs == 0 && pos != size) {
+            src_error(src, 0, "Expected %i values in scenario %i but found %i.", size, k + 1, pos);
+            ok = 0;
+        }
+    }
+
+    s->start[count] = t.nnz;
+    s->index = t.col;
+    s->value = t.value;
+    s->count = count;
+    free(t.row);
+    return ok;
+
+}
+
+// Read a problem in the text format from a loaded file.
+// The constraints are returned as written, see lp_normalize.
+linprog read_text(source* src) {
+
+    // Define the program to be read, every array is released on errors
+    linprog prog;
+    memset(&prog, 0, sizeof(prog));
+    prog.max = -1;
+    triplets t = { 0 };
+    const char* tok = 0;
+    size_t len = 0;
+
+    // Read variable count
+    if (!src_token(src, &tok, &len) || !tok_is(tok, len, "variables")) {
+        src_error(src, 0, "'variables' keyword expected.");
+        goto fail;
+    }
+    if (!src_token(src, &tok, &len) || !parse_int(tok, tok + len, &prog.vars)) {
+        src_error(src, 0, "Problem variable count expected but none found.");
+        goto fail;
+    }
+
+    // Read minmax mode
+    int max;
+    len = 0;
+    if (src_token(src, &tok, &len) && tok_is(tok, len, "max")) {
+        max = 1;
+    } else if (len > 0 && tok_is(tok, len, "min")) {
+        max = 0;
+    } else {
+        src_error(src, len ? tok : 0, "Objective goal expected but was not valid. (allowed: min, max)");
+        goto fail;
+    }
+
+    // Read coefficients (dense values or index:value pairs) up to the 'constraints' keyword
+    int pos = 0, col, sparse;
+    double val;
+    prog.c = vec(prog.vars);
+    memset(prog.c.data, 0, sizeof(double) * prog.vars);
+    for (;;) {
+        if (!src_token(src, &tok, &len)) {
+            src_error(src, 0, "'constraints' keyword expected following objective function definition.");
+            goto fail;
+        }
+        if (tok_is(tok, len, "constraints"))
+            break;
+        if (!read_coefficient(tok, len, prog.vars, &pos, &col, &val, &sparse)) {
+            src_error(src, tok, "Failed to read coefficient '%.*s'.", (int)len, tok);
+            goto fail;
+        }
+        prog.c.data[col] += val;
+    }
+
+    // Read constraints
+    int constraints;
+    if (!src_token(src, &tok, &len) || !parse_int(tok, tok + len, &constraints)) {
+        src_error(src, 0, "Failed to read constraint count.");
+        goto fail;
+    }
+
+    // Nonzeros of the constraint matrix, sized from the file so most files never regrow
+    size_t guess = src->size / 8 + 16;
+    t = trip(guess < INT_MAX / 2 ? (int)guess : INT_MAX / 2);
+
+    // Write how many constraints we have
+    prog.b = vec(constraints);
+    prog.sense = (signed char*)malloc(constraints > 0 ? constraints : 1);
+    for (int i = 0; i < constraints; i++) {
+
+        // Read coefficients up to the constraint type, rows are either dense or sparse
+        pos = 0;
+        int pairs = 0;
+        for (;;) {
+            if (!src_token(src, &tok, &len)) {
+                src_error(src, 0, "Failed to read constraint type of constraint %i.", i + 1);
+                goto fail;
+            }
+            if (tok_is(tok, len, "<=")) {
+                prog.sense[i] = SENSE_LE;
+                break;
+            } else if (tok_is(tok, len, ">=")) {
+                prog.sense[i] = SENSE_GE;
+                break;
+            } else if (tok_is(tok, len, "=")) {
+                prog.sense[i] = SENSE_EQ;
+                break;
+            }
+            if (!read_coefficient(tok, len, prog.vars, &pos, &col, &val, &sparse) || (sparse ? pos > 0 : pairs > 0)) {
+                src_error(src, tok, "Failed to read constraint coefficient '%.*s' in constraint %i.", (int)len, tok, i + 1);
+                goto fail;
+            }
+            pairs += sparse;
+            if (val != 0)
+                trip_add(&t, i, col, val);
+        }
+        if (pairs == 0 && pos != prog.vars) {
+            src_error(src, tok, "Expected %i coefficients in constraint %i but found %i.", prog.vars, i + 1, pos);
+            goto fail;
+        }
+
+        // Read bounds
+        len = 0;
+        if (!src_token(src, &tok, &len) || !parse_double(tok, tok + len, &prog.b.data[i])) {
+            src_error(src, len ? tok : 0, "Failed to read constraint bound b[%i].", i);
+            goto fail;
+        }
+
+    }
+
+    // Compress the constraint matrix
+    prog.a = sp_from_triplets(constraints, prog.vars, &t);
+    freetrip(&t);
+    memset(&t, 0, sizeof(t));
+
+    // Read the optional sections: variable bounds and scenarios
+    while (src_token(src, &tok, &len)) {
+        int count;
+        if (tok_is(tok, len, "scenarios") && !prog.scen.count) {
+            if (!read_scenarios(src, &prog, constraints))
+                goto fail;
+            continue;
+        }
+        if (!tok_is(tok, len, "bounds") || prog.lower) {
+            src_error(src, tok, "'bounds' or 'scenarios' keyword or end of file expected.");
+            goto fail;
+        }
+
+        // 'bounds K' followed by K lines of 'INDEX LOWER UPPER'
+        if (!src_token(src, &tok, &len) || !parse_int(tok, tok + len, &count)) {
+            src_error(src, 0, "Failed to read bound count.");
+            goto fail;
+        }
+        prog.lower = (double*)malloc(sizeof(double) * (prog.vars > 0 ? prog.vars : 1));
+        prog.upper = (double*)malloc(sizeof(double) * (prog.vars > 0 ? prog.vars : 1));
+        for (int j = 0; j < prog.vars; j++) {
+            prog.lower[j] = 0;
+            prog.upper[j] = INFINITY;
+        }
+        for (int k = 0; k < count; k++) {
+            int index;
+            double lower, upper;
+            if (!src_token(src, &tok, &len) || !parse_int(tok, tok + len, &index) || index < 1 || index > prog.vars) {
+                src_error(src, len ? tok : 0, "Variable index between 1 and %i expected in bound %i.", prog.vars, k + 1);
+                goto fail;
+            }
+            len = 0;
+            if (!src_token(src, &tok, &len) || !parse_bound(tok, tok + len, &lower) || lower == INFINITY) {
+                src_error(src, len ? tok : 0, "Failed to read lower bound of variable %i.", index);
+                goto fail;
+            }
+            len = 0;
+            if (!src_token(src, &tok, &len) || !parse_bound(tok, tok + len, &upper) || upper == -INFINITY || upper < lower) {
+                src_error(src, len ? tok : 0, "Failed to read upper bound of variable %i (at least its lower bound).", index);
+                goto fail;
+            }
+            prog.lower[index - 1] = lower;
+            prog.upper[index - 1] = upper;
+        }
+    }
+
+    // Return problem
+    prog.max = max;
+    return prog;
+
+fail:
+    freetrip(&t);
+    free(prog.c.data);
+    free(prog.b.data);
+    free(prog.sense);
+    freesp(&prog.a);
+    free(prog.lower);
+    free(prog.upper);
+    if (prog.scen.count > 0) {
+        free(prog.scen.objective);
+        free(prog.scen.start);
+        free(prog.scen.index);
+        free(prog.scen.value);
+    }
+    memset(&prog, 0, sizeof(prog));
+    prog.max = -1;
+    return prog;
+
+}
+
+// Header of a binary (.lpb) problem file, see the readme for the layout of the sections that follow it
+typedef struct {
+    char magic[4]; // "LPB1"
+    int vars; // The amount of variables (N)
+    int constraints; // The amount of constraints (M)
+    int max; // 1 to maximize, 0 to minimize
+    int layout; // LPB_DENSE or LPB_CSC
+    int bounded; // 1 if a bounds section follows the constraint matrix, else 0
+    long long nnz; // The amount of stored constraint entries (M * N for dense files)
+} lpb_header;
+
+#define LPB_DENSE 0
+#define LPB_CSC 1
+
+// Round a section size up so the next section starts 8-byte aligned.
+size_t lpb_pad(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// Read a problem in the binary format from a loaded file.
+// Vectors and CSC arrays point straight into the file contents, which are owned by the problem from now on
+// (and closed here if the file is not valid).
+linprog read_binary(source* src) {
+
+    linprog prog;
+    memset(&prog, 0, sizeof(prog));
+    prog.max = -1;
+
+    lpb_header h;
+    if (src->size < sizeof(h)) {
+        fprintf(stderr, "%s: Truncated binary header.\n", src->path);
+        goto fail;
+    }
+    memcpy(&h, src->data, sizeof(h));
+    if (h.vars < 0 || h.constraints < 0 || h.nnz < 0 || h.nnz > INT_MAX || (h.layout != LPB_DENSE && h.layout != LPB_CSC)
+        || (h.layout == LPB_DENSE && h.nnz != (long long)h.vars * h.constraints) || (h.bounded != 0 && h.bounded != 1)) {
+        fprintf(stderr, "%s: Invalid binary header.\n", src->path);
+        goto fail;
+    }
+
+    // Locate the sections
+    size_t n = (size_t)h.vars, m = (size_t)h.constraints, nnz = (size_t)h.nnz;
+    size_t offset = sizeof(h);
+    size_t cOffset = offset; offset += sizeof(double) * n;
+    size_t bOffset = offset; offset += sizeof(double) * m;
+    size_t senseOffset = offset; offset += lpb_pad(m);
+    size_t startOffset = offset, indexOffset = offset, valueOffset = offset;
+    if (h.layout == LPB_CSC) {
+        offset += lpb_pad(sizeof(int) * (n + 1));
+        indexOffset = offset; offset += lpb_pad(sizeof(int) * nnz);
+        valueOffset = offset;
+    }
+    offset += sizeof(double) * nnz;
+    size_t boundsOffset = offset;
+    if (h.bounded)
+        offset += 2 * sizeof(double) * n;
+    if (src->size < offset) {
+        fprintf(stderr, "%s: Truncated binary file (%zu of %zu bytes).\n", src->path, src->size, offset);
+        goto fail;
+    }
+
+    // Normalization scales rows in place, which only touches private copies of the mapped pages
+#ifdef SIMPLEX_MMAP
+    if (src->mapped)
+        mprotect((void*)src->data, src->size, PROT_READ | PROT_WRITE);
+#endif
+    char* data = (char*)src->data;
+
+    prog.vars = h.vars;
+    prog.c.size = h.vars;
+    prog.c.data = (double*)(data + cOffset);
+    prog.b.size = h.constraints;
+    prog.b.data = (double*)(data + bOffset);
+    prog.sense = (signed char*)(data + senseOffset);
+    for (size_t i = 0; i < m; i++) {
+        if (prog.sense[i] != SENSE_LE && prog.sense[i] != SENSE_GE && prog.sense[i] != SENSE_EQ) {
+            fprintf(stderr, "%s: Invalid type of constraint %zu.\n", src->path, i + 1);
+            goto fail;
+        }
+    }
+    if (h.bounded) {
+        prog.lower = (double*)(data + boundsOffset);
+        prog.upper = prog.lower + n;
+        for (size_t j = 0; j < n; j++) {
+            if (!(prog.lower[j] <= prog.upper[j]) || prog.lower[j] == INFINITY || prog.upper[j] == -INFINITY) {
+                fprintf(stderr, "%s: Invalid bounds of variable %zu.\n", src->path, j + 1);
+                goto fail;
+            }
+        }
+    }
+
+    if (h.layout == LPB_CSC) {
+
+        // Use the arrays in place after checking they describe a valid matrix
+        prog.a.rows = h.constraints;
+        prog.a.columns = h.vars;
+        prog.a.nnz = (int)nnz;
+        prog.a.start = (int*)(data + startOffset);
+        prog.a.index = (int*)(data + indexOffset);
+        prog.a.value = (double*)(data + valueOffset);
+        // (row indices strictly increasing within every column, the solvers expect no duplicate entries)
+        int valid = prog.a.start[0] == 0 && prog.a.start[n] == (int)nnz;
+        for (size_t j = 0; j < n && valid; j++)
+            valid = prog.a.start[j] <= prog.a.start[j + 1];
+        for (size_t j = 0; j < n && valid; j++)
+            for (int k = prog.a.start[j]; k < prog.a.start[j + 1] && valid; k++)
+                valid = prog.a.index[k] >= (k > prog.a.start[j] ? prog.a.index[k - 1] + 1 : 0) && prog.a.index[k] < h.constraints;
+        if (!valid) {
+            fprintf(stderr, "%s: Invalid sparse constraint matrix.\n", src->path);
+            goto fail;
+        }
+
+    } else {
+
+        // Dense rows are compressed like text input
+        const double* a = (const double*)(data + valueOffset);
+        triplets t = trip((int)(nnz < 16 ? 16 : nnz / 2));
+        for (size_t i = 0; i < m; i++)
+            for (size_t j = 0; j < n; j++)
+                if (a[i * n + j] != 0)
+                    trip_add(&t, (int)i, (int)j, a[i * n + j]);
+        prog.a = sp_from_triplets(h.constraints, h.vars, &t);
+        freetrip(&t);
+
+    }
+
+    prog.max = h.max ? 1 : 0;
+    prog.file = *src;
+    return prog;
+
+fail:
+    src_close(src);
+    memset(&prog, 0, sizeof(prog));
+    prog.max = -1;
+    return prog;
+
+}
+
+// Write a problem (as read, before lp_normalize) in the binary format.
+// Matrices that are at least two thirds full are stored dense, all others in CSC form.
+// Returns 0 if the file could not be written.
+int write_binary(linprog* prog, const char* path) {
+
+    FILE* pFile = fopen(path, "wb");
+    if (!pFile)
         return 0;
+
+    size_t n = (size_t)prog->vars, m = (size_t)prog->b.size;
+    lpb_header h;
+    memcpy(h.magic, "LPB1", 4);
+    h.vars = prog->vars;
+    h.constraints = prog->b.size;
+    h.max = prog->max;
+    h.layout = 3 * (size_t)prog->a.nnz >= 2 * m * n && m * n > 0 ? LPB_DENSE : LPB_CSC;
+    h.bounded = prog->lower ? 1 : 0;
+    h.nnz = h.layout == LPB_DENSE ? (long long)(m * n) : prog->a.nnz;
+
+    static const char zeros[8] = { 0 };
+    fwrite(&h, sizeof(h), 1, pFile);
+    fwrite(prog->c.data, sizeof(double), n, pFile);
+    fwrite(prog->b.data, sizeof(double), m, pFile);
+    fwrite(prog->sense, 1, m, pFile);
+    fwrite(zeros, 1, lpb_pad(m) - m, pFile);
+    if (h.layout == LPB_CSC) {
+        size_t nnz = (size_t)prog->a.nnz;
+        fwrite(prog->a.start, sizeof(int), n + 1, pFile);
+        fwrite(zeros, 1, lpb_pad(sizeof(int) * (n + 1)) - sizeof(int) * (n + 1), pFile);
+        fwrite(prog->a.index, sizeof(int), nnz, pFile);
+        fwrite(zeros, 1, lpb_pad(sizeof(int) * nnz) - sizeof(int) * nnz, pFile);
+        fwrite(prog->a.value, sizeof(double), nnz, pFile);
+    } else {
+        // Scatter the columns into the rows once and write them in one go
+        double* dense = (double*)calloc(m * n, sizeof(double));
+        if (!dense) {
+            fclose(pFile);
+            return 0;
+        }
+        for (size_t j = 0; j < n; j++)
+            for (int k = prog->a.start[j]; k < prog->a.start[j + 1]; k++)
+                dense[(size_t)prog->a.index[k] * n + j] += prog->a.value[k];
+        fwrite(dense, sizeof(double), m * n, pFile);
+        free(dense);
+    }
+    if (h.bounded) {
+        fwrite(prog->lower, sizeof(double), n, pFile);
+        fwrite(prog->upper, sizeof(double), n, pFile);
     }
 
-    // Read over all inputs
-    for (int i = 1; i < argc; i++) {
+    int ok = !ferror(pFile);
+    return fclose(pFile) == 0 && ok;
+
+}
+
+// Read a problem as written (text or binary, detected from the contents) from file ("-" reads stdin).
+linprog read_model(const char* pFilePath) {
+
+    linprog prog;
+    prog.max = -1;
+    prog.file.data = 0;
+    prog.scen.count = 0;
+
+    source src;
+    if (!src_open(&src, pFilePath)) {
+        fprintf(stderr, "Could not open '%s'.\n", pFilePath);
+        return prog;
+    }
+    if (src.size >= 4 && memcmp(src.data, "LPB1", 4) == 0) {
+        prog = read_binary(&src); // The arrays point into the file, it is released by freelp
+    } else {
+        prog = read_text(&src);
+        prog.file.data = 0;
+        src_close(&src);
+    }
+
+    return prog;
+
+}
+
+// Check if an array belongs to the problem rather than to the file it was loaded from.
+int lp_owns(linprog* prog, const void* p) {
+    const char* c = (const char*)p;
+    return !prog->file.data || c < prog->file.data || c >= prog->file.data + prog->file.size;
+}
+
+// Bring a problem to the form the solvers take: maximize c'x subject to Ax <= b and Ax = b.
+// '>=' rows are negated (their sense becomes SENSE_LE) and minimization negates c.
+void lp_normalize(linprog* prog) {
+
+    int m = prog->b.size;
+    spmatrix* a = &prog->a;
+
+    // Scenarios change the bounds and objective of the normalized problem
+    scenario_set* s = &prog->scen;
+    for (int k = 0; k < s->count; k++)
+        for (int e = s->start[k]; e < s->start[k + 1]; e++)
+            if (s->objective[k] ? !prog->max : prog->sense[s->index[e]] == SENSE_GE)
+                s->value[e] *= -1;
+
+    // Negate '>=' rows
+    for (int k = 0; k < a->nnz; k++)
+        if (prog->sense[a->index[k]] == SENSE_GE)
+            a->value[k] *= -1;
+    for (int i = 0; i < m; i++) {
+        if (prog->sense[i] == SENSE_GE) {
+            prog->b.data[i] *= -1;
+            prog->sense[i] = SENSE_LE;
+        }
+    }
+
+    // Negate all coefficients when minimizing
+    if (!prog->max)
+        vec_mul(&prog->c, -1);
+
+}
+
+// Read a problem from file ("-" reads stdin) in the form the solvers take.
+linprog read_problem(const char* pFilePath) {
+    linprog prog = read_model(pFilePath);
+    if (prog.max != -1)
+        lp_normalize(&prog);
+    return prog;
+}
+
+// Presolve settings
+typedef struct {
+    int enabled; // Reduce every problem before solving it
+} presolve_options;
+
+// The presolve settings (set from the command line)
+presolve_options presolve_opts = { 0 };
+
+// Hash of the direction of a row: its columns, the signs of its values relative to the first one and the
+// ratio of its last and first value (rounded to a float, so parallel rows almost always hash the same).
+unsigned long long row_hash(const int* column, const double* value, const char* alive, int begin, int end) {
+    unsigned long long h = 14695981039346656037ULL;
+    double first = 0, last = 0;
+    for (int k = begin; k < end; k++) {
+        if (!alive[column[k]])
+            continue;
+        if (first == 0)
+            first = value[k];
+        last = value[k];
+        h = (h ^ ((unsigned long long)column[k] << 1 ^ ((value[k] > 0) == (first > 0)))) * 1099511628211ULL;
+    }
+    float ratio = (float)(last / first);
+    unsigned int bits;
+    memcpy(&bits, &ratio, sizeof(bits));
+    return (h ^ bits) * 1099511628211ULL;
+}
+
+// Check if the rows [b1, e1) and [b2, e2) of a row-wise matrix are parallel, returns the factor of the
+// second one (0 if they are not).
+double row_factor(const int* column, const double* value, const char* alive, int b1, int e1, int b2, int e2) {
+    double s = 0;
+    for (;;) {
+        while (b1 < e1 && !alive[column[b1]])
+            b1++;
+        while (b2 < e2 && !alive[column[b2]])
+            b2++;
+        if (b1 == e1 || b2 == e2)
+            return b1 == e1 && b2 == e2 ? s : 0;
+        if (column[b1] != column[b2])
+            return 0;
+        if (s == 0)
+            s = value[b2] / value[b1];
+        else if (fabs(value[b2] - s * value[b1]) > PRESOLVE_EPS * (1 + fabs(value[b2])))
+            return 0;
+        b1++;
+        b2++;
+    }
+}
+
+// Order of rows by hash
+typedef struct {
+    unsigned long long hash;
+    int row;
+} row_key;
+
+int compare_row_keys(const void* a, const void* b) {
+    const row_key* x = (const row_key*)a;
+    const row_key* y = (const row_key*)b;
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return x->row - y->row;
+}
+
+// Reduce a problem in the form the solvers take (see lp_normalize) until no reduction applies:
+//  - empty rows are removed,
+//  - singleton rows become bounds of their variable,
+//  - of two parallel rows the one implied by the other is removed,
+//  - fixed columns (equal bounds) are removed, moving their contribution into the bounds,
+//  - dominated columns are fixed at the bound that cannot make a row or the objective worse: a column with
+//    a cost of at most zero and no positive entry at its lower bound, one with a cost of at least zero and
+//    no negative entry at its upper bound (both only in '<=' rows).
+// Reductions that would show that the problem is infeasible are not made, which leaves it to the solver.
+// Returns the reduced problem (owning its arrays) and fills 'post' to map its solution back.
+linprog presolve(linprog* prog, postsolve* post) {
+
+    double start = now();
+    int m = prog->b.size, n = prog->vars;
+    spmatrix* a = &prog->a;
+    memset(post, 0, sizeof(postsolve));
+    post->rows = m;
+    post->columns = n;
+    post->a = a;
+    post->b = prog->b.data;
+    post->stack = (postsolve_step*)malloc(sizeof(postsolve_step) * (n > 0 ? n : 1));
+
+    // Row-wise copy of the constraint matrix, entries in column order
+    int* rowStart = (int*)calloc(m + 1, sizeof(int));
+    int* rowColumn = (int*)malloc(sizeof(int) * (a->nnz > 0 ? a->nnz : 1));
+    double* rowValue = (double*)malloc(sizeof(double) * (a->nnz > 0 ? a->nnz : 1));
+    for (int k = 0; k < a->nnz; k++)
+        rowStart[a->index[k] + 1]++;
+    for (int i = 0; i < m; i++)
+        rowStart[i + 1] += rowStart[i];
+    int* fill = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    memcpy(fill, rowStart, sizeof(int) * m);
+    for (int j = 0; j < n; j++) {
+        for (int k = a->start[j]; k < a->start[j + 1]; k++) {
+            int at = fill[a->index[k]]++;
+            rowColumn[at] = j;
+            rowValue[at] = a->value[k];
+        }
+    }
+    free(fill);
+
+    // Working copies of the bounds
+    double* b = (double*)malloc(sizeof(double) * (m > 0 ? m : 1));
+    double* lower = (double*)malloc(sizeof(double) * (n > 0 ? n : 1));
+    double* upper = (double*)malloc(sizeof(double) * (n > 0 ? n : 1));
+    memcpy(b, prog->b.data, sizeof(double) * m);
+    for (int j = 0; j < n; j++) {
+        lower[j] = prog->lower ? prog->lower[j] : 0;
+        upper[j] = prog->upper ? prog->upper[j] : INFINITY;
+    }
+    char* rowAlive = (char*)malloc(m > 0 ? m : 1);
+    char* columnAlive = (char*)malloc(n > 0 ? n : 1);
+    int* rowCount = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    memset(rowAlive, 1, m);
+    memset(columnAlive, 1, n);
+    for (int i = 0; i < m; i++)
+        rowCount[i] = rowStart[i + 1] - rowStart[i];
+    row_key* keys = (row_key*)malloc(sizeof(row_key) * (m > 0 ? m : 1));
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+
+        // Empty and singleton rows
+        for (int i = 0; i < m; i++) {
+            if (!rowAlive[i] || rowCount[i] > 1)
+                continue;
+            double tol = PRESOLVE_EPS * (1 + fabs(b[i]));
+            if (rowCount[i] == 0) {
+                if (prog->sense[i] == SENSE_EQ ? fabs(b[i]) > tol : b[i] < -tol)
+                    continue;
+                post->empty++;
+            } else {
+                int k = rowStart[i];
+                while (!columnAlive[rowColumn[k]])
+                    k++;
+                int j = rowColumn[k];
+                double bound = b[i] / rowValue[k], lo = lower[j], up = upper[j];
+                if (prog->sense[i] == SENSE_EQ || rowValue[k] > 0)
+                    up = fmin(up, bound);
+                if (prog->sense[i] == SENSE_EQ || rowValue[k] < 0)
+                    lo = fmax(lo, bound);
+                if (lo > up + PRESOLVE_EPS * (1 + fabs(bound)))
+                    continue;
+                lower[j] = lo;
+                upper[j] = up < lo ? lo : up;
+                post->singleton++;
+            }
+            rowAlive[i] = 0;
+            changed = 1;
+        }
+
+        // Fixed and dominated columns
+        for (int j = 0; j < n; j++) {
+            if (!columnAlive[j])
+                continue;
+            double value, cost = prog->c.data[j];
+            if (lower[j] == upper[j]) {
+                value = lower[j];
+                post->fixed++;
+            } else {
+                int down = 1, up = 1;
+                for (int k = a->start[j]; k < a->start[j + 1] && (down || up); k++) {
+                    int i = a->index[k];
+                    if (!rowAlive[i])
+                        continue;
+                    if (prog->sense[i] == SENSE_EQ)
+                        down = up = 0;
+                    else if (a->value[k] > 0)
+                        up = 0;
+                    else
+                        down = 0;
+                }
+                if (down && cost <= 0 && lower[j] > -INFINITY)
+                    value = lower[j];
+                else if (up && cost >= 0 && upper[j] < INFINITY)
+                    value = upper[j];
+                else if (down && up && cost == 0)
+                    value = 0; // An empty free column without cost
+                else
+                    continue;
+                post->dominated++;
+            }
 
-        // Log
-        printf("Solving problem: %s\n", args[i]);
+            // Move the column into the bounds and onto the postsolve stack
+            columnAlive[j] = 0;
+            for (int k = a->start[j]; k < a->start[j + 1]; k++) {
+                int i = a->index[k];
+                if (rowAlive[i]) {
+                    b[i] -= a->value[k] * value;
+                    rowCount[i]--;
+                }
+            }
+            post->offset += cost * value;
+            post->stack[post->count].column = j;
+            post->stack[post->count++].value = value;
+            changed = 1;
+        }
 
-        // Read simplex
-        linprog p = read_problem(args[i]);
-        if (p.max == -1) {
-            printf("Failed to read program file: %s\n", args[i]);
+        // Parallel rows, found by sorting the rows by the hash of their direction (only once the cheaper
+        // reductions found nothing)
+        if (changed)
             continue;
+        int count = 0;
+        for (int i = 0; i < m; i++) {
+            if (!rowAlive[i] || rowCount[i] == 0)
+                continue;
+            keys[count].hash = row_hash(rowColumn, rowValue, columnAlive, rowStart[i], rowStart[i + 1]);
+            keys[count++].row = i;
+        }
+        qsort(keys, count, sizeof(row_key), compare_row_keys);
+        for (int g = 0; g < count;) {
+            int end = g + 1;
+            while (end < count && keys[end].hash == keys[g].hash)
+                end++;
+            for (int x = g; x < end; x++) {
+                for (int y = g; y < x && rowAlive[keys[x].row]; y++) {
+                    int i = keys[y].row, k = keys[x].row;
+                    if (!rowAlive[i])
+                        continue;
+                    double s = row_factor(rowColumn, rowValue, columnAlive, rowStart[i], rowStart[i + 1], rowStart[k], rowStart[k + 1]);
+                    if (s == 0)
+                        continue;
+
+                    // Row k is s times row i: compare the bounds in terms of row i
+                    double bk = b[k] / s, tol = PRESOLVE_EPS * (1 + fabs(b[i]) + fabs(bk));
+                    int eqi = prog->sense[i] == SENSE_EQ, eqk = prog->sense[k] == SENSE_EQ, drop = -1;
+                    if (eqi && eqk)
+                        drop = fabs(b[i] - bk) <= tol ? k : -1;
+                    else if (eqi)
+                        drop = (s > 0 ? b[i] <= bk + tol : b[i] >= bk - tol) ? k : -1;
+                    else if (eqk)
+                        drop = bk <= b[i] + tol ? i : -1;
+                    else if (s > 0)
+                        drop = bk >= b[i] ? k : i;
+                    if (drop == -1)
+                        continue;
+                    rowAlive[drop] = 0;
+                    post->duplicate++;
+                    changed = 1;
+                }
+            }
+            g = end;
         }
 
-        // Find the optimal solution and exit
-        dictionary optimal = simplex(&p.c, &p.b, &p.a);        
-        print_solution(&optimal);
+    }
 
-        // Cleanup
-        freemat(&p.a);
-        freevec(&p.c);
-        freevec(&p.b);
-        
+    // Build the reduced problem
+    linprog r;
+    r.max = prog->max;
+    r.file.data = 0;
+    r.scen.count = 0;
+    r.vars = 0;
+    int rows = 0;
+    post->columnMap = (int*)malloc(sizeof(int) * (n > 0 ? n : 1));
+    post->rowMap = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    int* newRow = rowCount; // Reused: the reduced row of every original row
+    for (int i = 0; i < m; i++) {
+        newRow[i] = rowAlive[i] ? rows : -1;
+        if (rowAlive[i])
+            post->rowMap[rows++] = i;
+    }
+    post->keptRows = rows;
+    int bounded = 0;
+    for (int j = 0; j < n; j++) {
+        if (columnAlive[j]) {
+            post->columnMap[r.vars++] = j;
+            bounded |= lower[j] != 0 || upper[j] != INFINITY;
+        }
     }
+    r.c = vec(r.vars);
+    r.b = vec(rows);
+    r.sense = (signed char*)malloc(rows > 0 ? rows : 1);
+    r.lower = bounded ? (double*)malloc(sizeof(double) * r.vars) : 0;
+    r.upper = bounded ? (double*)malloc(sizeof(double) * r.vars) : 0;
+    r.a.rows = rows;
+    r.a.columns = r.vars;
+    r.a.start = (int*)malloc(sizeof(int) * (r.vars + 1));
+    r.a.index = (int*)malloc(sizeof(int) * (a->nnz > 0 ? a->nnz : 1));
+    r.a.value = (double*)malloc(sizeof(double) * (a->nnz > 0 ? a->nnz : 1));
+    r.a.nnz = 0;
+    for (int q = 0; q < r.vars; q++) {
+        int j = post->columnMap[q];
+        r.c.data[q] = prog->c.data[j];
+        if (bounded) {
+            r.lower[q] = lower[j];
+            r.upper[q] = upper[j];
+        }
+        r.a.start[q] = r.a.nnz;
+        for (int k = a->start[j]; k < a->start[j + 1]; k++) {
+            if (rowAlive[a->index[k]]) {
+                r.a.index[r.a.nnz] = newRow[a->index[k]];
+                r.a.value[r.a.nnz++] = a->value[k];
+            }
+        }
+    }
+    r.a.start[r.vars] = r.a.nnz;
+    for (int q = 0; q < rows; q++) {
+        r.b.data[q] = b[post->rowMap[q]];
+        r.sense[q] = prog->sense[post->rowMap[q]];
+    }
+
+    // Cleanup
+    free(rowStart);
+    free(rowColumn);
+    free(rowValue);
+    free(b);
+    free(lower);
+    free(upper);
+    free(rowAlive);
+    free(columnAlive);
+    free(rowCount);
+    free(keys);
+    post->time = now() - start;
+    return r;
+
+}
+
+// Release the postsolve information of a presolved problem.
+void freepost(postsolve* post) {
+    free(post->rowMap);
+    free(post->columnMap);
+    free(post->stack);
+}
+
+// Scaling settings
+typedef struct {
+    int enabled; // Scale every problem before solving it
+    int maxPasses; // The most geometric mean passes
+} scaling_options;
+
+// The scaling settings (set from the command line)
+scaling_options scaling_opts = { 0, 20 };
+
+// Get the ratio of the largest and smallest magnitude in A with the rows and columns multiplied by 'row' and
+// 'column', and optionally the smallest and largest magnitude of every row and column.
+double scaled_range(spmatrix* a, double* row, double* column, double* rowMin, double* rowMax, double* columnMin, double* columnMax) {
+    double lo = INFINITY, hi = 0;
+    if (rowMin) {
+        for (int i = 0; i < a->rows; i++) {
+            rowMin[i] = INFINITY;
+            rowMax[i] = 0;
+        }
+    }
+    for (int j = 0; j < a->columns; j++) {
+        double cmin = INFINITY, cmax = 0;
+        for (int k = a->start[j]; k < a->start[j + 1]; k++) {
+            int i = a->index[k];
+            double v = fabs(a->value[k]) * row[i] * column[j];
+            if (v == 0)
+                continue;
+            cmin = v < cmin ? v : cmin;
+            cmax = v > cmax ? v : cmax;
+            if (rowMin) {
+                rowMin[i] = v < rowMin[i] ? v : rowMin[i];
+                rowMax[i] = v > rowMax[i] ? v : rowMax[i];
+            }
+        }
+        if (columnMin) {
+            columnMin[j] = cmin;
+            columnMax[j] = cmax;
+        }
+        lo = cmin < lo ? cmin : lo;
+        hi = cmax > hi ? cmax : hi;
+    }
+    return hi > 0 ? hi / lo : 1;
+}
+
+// Round a scaling factor to the nearest power of two, which scales values without rounding errors.
+double pow2_factor(double f) {
+    return f > 0 && f < INFINITY ? exp2(round(log2(f))) : 1;
+}
+
+// Scale a problem in the form the solvers take in place: geometric mean scaling of the rows and columns of A
+// (every row and column divided by the square root of its smallest and largest magnitude, repeated until the
+// range of A stops shrinking by a tenth), then equilibration (the largest magnitude of every row and then
+// every column made one). All factors are powers of two. b, c and the variable bounds are scaled along.
+void scale_lp(linprog* prog, scaling* s) {
+
+    spmatrix* a = &prog->a;
+    int m = a->rows, n = a->columns;
+    s->row = (double*)malloc(sizeof(double) * (m > 0 ? m : 1));
+    s->column = (double*)malloc(sizeof(double) * (n > 0 ? n : 1));
+    s->unscale = (double*)malloc(sizeof(double) * ((size_t)n + m + 1));
+    double* rowMin = (double*)malloc(sizeof(double) * (m > 0 ? m : 1));
+    double* rowMax = (double*)malloc(sizeof(double) * (m > 0 ? m : 1));
+    double* columnMin = (double*)malloc(sizeof(double) * (n > 0 ? n : 1));
+    double* columnMax = (double*)malloc(sizeof(double) * (n > 0 ? n : 1));
+    for (int i = 0; i < m; i++)
+        s->row[i] = 1;
+    for (int j = 0; j < n; j++)
+        s->column[j] = 1;
+
+    // Geometric mean passes
+    double range = s->before = scaled_range(a, s->row, s->column, 0, 0, 0, 0);
+    s->passes = 0;
+    while (s->passes < scaling_opts.maxPasses && range > 1) {
+        scaled_range(a, s->row, s->column, rowMin, rowMax, 0, 0);
+        for (int i = 0; i < m; i++)
+            if (rowMax[i] > 0)
+                s->row[i] /= sqrt(rowMin[i] * rowMax[i]);
+        scaled_range(a, s->row, s->column, 0, 0, columnMin, columnMax);
+        for (int j = 0; j < n; j++)
+            if (columnMax[j] > 0)
+                s->column[j] /= sqrt(columnMin[j] * columnMax[j]);
+        s->passes++;
+        double next = scaled_range(a, s->row, s->column, 0, 0, 0, 0);
+        if (next > 0.9 * range)
+            break;
+        range = next;
+    }
+
+    // Equilibration
+    scaled_range(a, s->row, s->column, rowMin, rowMax, 0, 0);
+    for (int i = 0; i < m; i++)
+        s->row[i] = pow2_factor(rowMax[i] > 0 ? s->row[i] / rowMax[i] : 1);
+    scaled_range(a, s->row, s->column, 0, 0, columnMin, columnMax);
+    for (int j = 0; j < n; j++)
+        s->column[j] = pow2_factor(columnMax[j] > 0 ? s->column[j] / columnMax[j] : 1);
+    s->after = scaled_range(a, s->row, s->column, 0, 0, 0, 0);
+
+    // Scale the problem: A' = R A C, b' = R b, c' = C c and bounds divided by C
+    for (int j = 0; j < n; j++) {
+        for (int k = a->start[j]; k < a->start[j + 1]; k++)
+            a->value[k] *= s->row[a->index[k]] * s->column[j];
+        prog->c.data[j] *= s->column[j];
+        if (prog->lower) {
+            prog->lower[j] /= s->column[j];
+            prog->upper[j] /= s->column[j];
+        }
+    }
+    for (int i = 0; i < m; i++)
+        prog->b.data[i] *= s->row[i];
+    scenario_set* scen = &prog->scen;
+    for (int k = 0; k < scen->count; k++)
+        for (int e = scen->start[k]; e < scen->start[k + 1]; e++)
+            scen->value[e] *= scen->objective[k] ? s->column[scen->index[e]] : s->row[scen->index[e]];
+
+    // x = C x' and w = R^-1 w'
+    s->unscale[0] = 1;
+    for (int j = 0; j < n; j++)
+        s->unscale[j + 1] = s->column[j];
+    for (int i = 0; i < m; i++)
+        s->unscale[n + 1 + i] = 1 / s->row[i];
+
+    free(rowMin);
+    free(rowMax);
+    free(columnMin);
+    free(columnMax);
+
+}
+
+// Release the factors of a scaled problem.
+void freescaling(scaling* s) {
+    free(s->row);
+    free(s->column);
+    free(s->unscale);
+}
+
+// Log the effect of scaling and, at trace level, every factor.
+void log_scaling(writer* out, scaling* s, int rows, int columns) {
+    if (out->level < VERBOSITY_NORMAL)
+        return;
+    double rmin = INFINITY, rmax = 0, cmin = INFINITY, cmax = 0;
+    for (int i = 0; i < rows; i++) {
+        rmin = fmin(rmin, s->row[i]);
+        rmax = fmax(rmax, s->row[i]);
+    }
+    for (int j = 0; j < columns; j++) {
+        cmin = fmin(cmin, s->column[j]);
+        cmax = fmax(cmax, s->column[j]);
+    }
+    wr_printf(out, "Scaling: %i geometric mean passes, coefficient range %.3g before and %.3g after, row factors %g to %g, column factors %g to %g\n",
+        s->passes, s->before, s->after, rows ? rmin : 1, rows ? rmax : 1, columns ? cmin : 1, columns ? cmax : 1);
+    if (out->level < VERBOSITY_TRACE)
+        return;
+    wr_printf(out, "Row factors:");
+    for (int i = 0; i < rows; i++)
+        wr_printf(out, " %g", s->row[i]);
+    wr_printf(out, "\nColumn factors:");
+    for (int j = 0; j < columns; j++)
+        wr_printf(out, " %g", s->column[j]);
+    wr_printf(out, "\n");
+}
+
+// Release a problem and the file it was loaded from.
+void freelp(linprog* prog) {
+    if (lp_owns(prog, prog->c.data))
+        freevec(&prog->c);
+    if (lp_owns(prog, prog->b.data))
+        freevec(&prog->b);
+    if (lp_owns(prog, prog->sense))
+        free(prog->sense);
+    if (lp_owns(prog, prog->a.start))
+        freesp(&prog->a);
+    if (prog->lower && lp_owns(prog, prog->lower)) {
+        free(prog->lower);
+        free(prog->upper);
+    }
+    if (prog->scen.count > 0) {
+        free(prog->scen.objective);
+        free(prog->scen.start);
+        free(prog->scen.index);
+        free(prog->scen.value);
+    }
+    if (prog->file.data)
+        src_close(&prog->file);
+}
+
+// The solvers a problem can be solved with (see solve_file)
+#define ENGINE_TABLEAU 0
+#define ENGINE_REVISED 1
+#define ENGINE_IPM 2
+
+// The names of the engines on the command line, by ENGINE_*
+const char* engine_names[] = { "tableau", "revised", "ipm" };
+
+// Warm start settings
+typedef struct {
+    const char* load; // The basis file every solve starts from (0 to start from the slack basis)
+    const char* save; // The file the final basis is written to (0 to not save it)
+} warm_options;
+
+// The warm start settings (set from the command line)
+warm_options warm_opts = { 0, 0 };
+
+#ifdef SIMPLEX_STATS
+// Print a JSON stats record after every solution (set from the command line)
+int stats_output = 0;
+
+// Write the statistics of the last solve of problem file 'path' ('rows' x 'columns' with 'nnz' nonzeros,
+// after presolve) as one line of JSON. 'scenario' is the 1-based scenario solved, or 0 for the problem itself.
+void print_stats(writer* out, const char* path, int scenario, dictionary* d, int engine, int rows, int columns, int nnz, double total) {
+    const char* status = d->state == SIMPLEX_STATE_SUCCESS ? "optimal" : d->state == SIMPLEX_STATE_INFEASIBLE ? "infeasible" :
+                         d->state == SIMPLEX_STATE_UNBOUNDED ? "unbounded" : "iteration_limit";
+    wr_printf(out, "{\"file\": \"");
+    for (const char* c = path; *c; c++)
+        wr_printf(out, *c == '"' || *c == '\\' ? "\\%c" : (unsigned char)*c < 32 ? "\\u%04x" : "%c", *c);
+    wr_printf(out, "\", \"scenario\": %i, \"engine\": \"%s\", \"status\": \"%s\", \"rows\": %i, \"columns\": %i, \"nonzeros\": %i, ",
+        scenario, engine_names[engine], status, rows, columns, nnz);
+    wr_printf(out, "\"parse_ms\": %.4f, \"presolve_ms\": %.4f, \"scale_ms\": %.4f, \"create_ms\": %.4f, \"pricing_ms\": %.4f, "
+        "\"ratio_ms\": %.4f, \"update_ms\": %.4f, \"barrier_ms\": %.4f, \"solve_ms\": %.4f, \"total_ms\": %.4f, ", 1000.0 * stats.parse,
+        1000.0 * stats.presolve, 1000.0 * stats.scale, 1000.0 * stats.create, 1000.0 * stats.pricing, 1000.0 * stats.ratio,
+        1000.0 * stats.update, 1000.0 * stats.barrier, 1000.0 * stats.solve, 1000.0 * total);
+    wr_printf(out, "\"phase_one_iterations\": %li, \"phase_two_iterations\": %li, \"degenerate_iterations\": %li, "
+        "\"refactorizations\": %li, \"barrier_steps\": %li, \"peak_tableau_bytes\": %zu}\n\n", stats.iterations[0], stats.iterations[1],
+        stats.degenerate, stats.refactors, stats.steps, stats.peak);
+}
+#endif
+
+// Get the size of the arena that solving a problem with 'rows' constraints and 'columns' variables
+// takes with 'engine' (ENGINE_*): two tableaux (the initial and auxiliary dictionary) for the tableau engine,
+// and the work arrays plus the eta pool for the revised engine, whose LU factors are left to the growth of
+// the arena. The interior point engine adds its normal matrix, work vectors and the crossover basis to the
+// revised engine it crosses over with.
+size_t context_size(int rows, int columns, int engine) {
+    size_t m = rows > 0 ? rows : 1, n = columns, vars = n + m + 2, size;
+    if (engine != ENGINE_TABLEAU) {
+        size = vars * (5 * sizeof(double) + 2 * sizeof(int) + sizeof(var_form)) +
+               m * (7 * sizeof(int) + 5 * sizeof(double)) + REVISED_REFACTOR * m * (sizeof(int) + sizeof(double)) +
+               (m + 1) * mat_stride(1) * sizeof(double);
+        if (engine == ENGINE_IPM)
+            size += m * mat_stride(rows) * sizeof(double) + 24 * (2 * n + m) * sizeof(double) +
+                    vars * (sizeof(crossover_candidate) + sizeof(int) + 2);
+    } else {
+        size = 2 * ((m + 1) * mat_stride(columns + 2) * sizeof(double) + vars * (sizeof(int) + 1 + sizeof(var_form))) +
+               4 * (n + 2) * sizeof(double) + (m + 1) * sizeof(double);
+    }
+    return size + 32 * CACHE_LINE; // Every allocation is padded to a cache line
+}
+
+// Set the values that scenario 'k' of 'prog' replaces in 'c' and 'b' (copies of the objective and bounds of
+// 'prog'), or put the values of 'prog' back if 'restore' is set.
+void scenario_apply(linprog* prog, int k, vector* c, vector* b, int restore) {
+    scenario_set* s = &prog->scen;
+    vector* target = s->objective[k] ? c : b;
+    vector* base = s->objective[k] ? &prog->c : &prog->b;
+    for (int e = s->start[k]; e < s->start[k + 1]; e++)
+        target->data[s->index[e]] = restore ? base->data[s->index[e]] : s->value[e];
+}
+
+// The scenarios of a problem, solved on the pool as one chain per block
+typedef struct {
+    linprog* prog; // The problem in the form the solvers take (scaled if 'scale' is set)
+    scaling* scale; // Takes the solutions back to the problem before scaling (0 if not scaled), not owned
+    basis* start; // The optimal basis of the problem itself, where every chain starts (varc 0 if there is none)
+    const char* path; // The problem file
+    int revised; // Solve with the revised simplex method (the tableau method if 0)
+    writer* chains; // The output of every chain
+} scenario_task;
+
+// Pool task solving scenarios [begin, end) one after another into the output of chain 'block'. Each one
+// starts from the optimal basis of the one before if both change the same vector, and otherwise from the
+// basis of the problem itself: that one is still optimal for the objective (bounds) the scenario keeps, so
+// it stays dual feasible after a bound change and primal feasible after an objective change, while the
+// basis of a scenario of the other kind is usually neither. The tableau engine re-optimizes the last
+// dictionary in place (see reoptimize), so it lives on the heap; the revised engine starts over from the
+// saved basis with a context reset for every scenario.
+void scenario_chain(void* arg, int block, int begin, int end) {
+
+    scenario_task* t = (scenario_task*)arg;
+    linprog* p = t->prog;
+    writer* out = &t->chains[block];
+    vector c = vec(p->c.size), b = vec(p->b.size);
+    vec_copy(&p->c, &c);
+    vec_copy(&p->b, &b);
+    var_bounds vb = { p->lower, p->upper };
+    var_bounds* bounds = p->lower ? &vb : 0;
+    simplex_context ctx = context(0);
+    basis* from = t->start->varc ? t->start : 0;
+    basis last;
+    last.vars = 0;
+    dictionary d;
+    int have = 0;
+
+    for (int k = begin; k < end; k++) {
+
+        // Bounds and objective of the scenario
+        if (k > begin) {
+            scenario_apply(p, k - 1, &c, &b, 1);
+            if (p->scen.objective[k] != p->scen.objective[k - 1] && have) {
+                if (!t->revised)
+                    freedic(&d);
+                from = t->start->varc ? t->start : 0;
+                have = 0;
+            }
+        }
+        scenario_apply(p, k, &c, &b, 0);
+        wr_printf(out, "Solving scenario %i of %i\n", k + 1, p->scen.count);
+#ifdef SIMPLEX_STATS
+        memset(&stats, 0, sizeof(stats));
+#endif
+
+        // Solve it from the last basis
+        STATS_CLOCK(solve);
+        if (t->revised) {
+            context_reset(&ctx, context_size(b.size, c.size, ENGINE_REVISED));
+            d = revised_simplex(&c, &b, &p->a, p->sense, bounds, from, &ctx, out);
+        } else if (have) {
+            d = reoptimize(d, &c, &b, &p->a, p->sense, bounds);
+        } else if (from) {
+            d = simplex_warm(&c, &b, &p->a, p->sense, bounds, from, 0, out);
+        } else {
+            d = simplex(&c, &b, &p->a, p->sense, bounds, 0, out);
+        }
+        STATS_TIME(solve, solve);
+        d.scale = t->scale;
+        print_solution(&d);
+#ifdef SIMPLEX_STATS
+        if (stats_output)
+            print_stats(out, t->path, k + 1, &d, t->revised ? ENGINE_REVISED : ENGINE_TABLEAU, b.size, c.size, p->a.nnz, stats.solve);
+#endif
+
+        // Keep the basis for the next one
+        int optimal = d.state == SIMPLEX_STATE_SUCCESS;
+        if (t->revised) {
+            freebasis(&last);
+            last.vars = 0;
+            if (optimal)
+                last = save_basis(&d);
+            from = optimal ? &last : t->start->varc ? t->start : 0;
+            freedic(&d);
+        } else if (!optimal) {
+            freedic(&d);
+        }
+        have = optimal;
+
+    }
+
+    if (have && !t->revised)
+        freedic(&d);
+    freebasis(&last);
+    freecontext(&ctx);
+    freevec(&c);
+    freevec(&b);
+
+}
+
+// Solve and print the scenarios of problem 'p' (in the form the solvers take), whose own optimal
+// dictionary is 'optimal'. The scenarios are split into one chain of consecutive scenarios per thread of
+// the pool, the output is written in scenario order. The interior point engine leaves the scenarios to the
+// revised engine, which starts from its crossover basis.
+void solve_scenarios(const char* path, linprog* p, dictionary* optimal, scaling* scale, int engine, writer* out) {
+
+    scenario_task t;
+    t.prog = p;
+    t.scale = scale;
+    t.path = path;
+    t.revised = engine != ENGINE_TABLEAU;
+    basis start;
+    start.varc = 0;
+    start.vars = 0;
+    if (optimal->state == SIMPLEX_STATE_SUCCESS && optimal->varc == p->vars)
+        start = save_basis(optimal);
+    t.start = &start;
+    t.chains = (writer*)malloc(sizeof(writer) * pool.threads);
+    for (int i = 0; i < pool.threads; i++)
+        t.chains[i] = wr(0, out->level);
+
+    double begin = now();
+    int chains = pool_run(scenario_chain, &t, p->scen.count, LONG_MAX);
+    double time = now() - begin;
+    for (int i = 0; i < pool.threads; i++) {
+        wr_printf(out, "%.*s", (int)t.chains[i].size, t.chains[i].data);
+        freewr(&t.chains[i]);
+    }
+    if (out->level >= VERBOSITY_NORMAL)
+        wr_printf(out, "Solved %i scenarios in %i chains in %.3f ms\n\n", p->scen.count, chains, 1000.0 * time);
+
+    free(t.chains);
+    freebasis(&start);
+
+}
+
+// Read, solve and print a problem file with 'engine' (ENGINE_*). The solver memory comes from 'ctx' (which
+// is reset first), or from the heap if it is 0. The interior point engine does not start from a saved basis.
+void solve_file(const char* path, int engine, simplex_context* ctx, writer* out) {
+
+    // Log
+    wr_printf(out, "Solving problem: %s\n", path);
+
+    // Read simplex
+#ifdef SIMPLEX_STATS
+    memset(&stats, 0, sizeof(stats));
+#endif
+    STATS_CLOCK(begin);
+    linprog p = read_problem(path);
+    STATS_TIME(parse, begin);
+    if (p.max == -1) {
+        wr_printf(out, "Failed to read program file: %s\n", path);
+        return;
+    }
+
+    // Reduce the problem, unless a basis of the full problem is loaded or saved or it has scenarios
+    postsolve post;
+    int reduced = presolve_opts.enabled && !warm_opts.load && !warm_opts.save && !p.scen.count;
+    linprog original = p;
+    if (reduced) {
+        STATS_CLOCK(start);
+        p = presolve(&original, &post);
+        STATS_TIME(presolve, start);
+        if (out->level >= VERBOSITY_NORMAL)
+            wr_printf(out, "Presolve: removed %i of %i rows (%i empty, %i singleton, %i duplicate) and %i of %i columns (%i fixed, %i dominated) in %.3f ms\n",
+                post.rows - p.b.size, post.rows, post.empty, post.singleton, post.duplicate, post.count, post.columns, post.fixed, post.dominated,
+                1000.0 * post.time);
+    }
+
+    // Scale the (reduced) problem
+    scaling scale;
+    if (scaling_opts.enabled) {
+        STATS_CLOCK(start);
+        scale_lp(&p, &scale);
+        STATS_TIME(scale, start);
+        log_scaling(out, &scale, p.b.size, p.vars);
+    }
+
+    // Read the saved basis to start from
+    basis start;
+    start.varc = 0;
+    start.vars = 0;
+    if (warm_opts.load) {
+        start = read_basis(warm_opts.load);
+        if (start.varc == 0)
+            wr_printf(out, "Failed to read basis file: %s\n", warm_opts.load);
+    }
+
+    // Find the optimal solution
+    if (ctx)
+        context_reset(ctx, context_size(p.b.size, p.vars, engine));
+    var_bounds vb = { p.lower, p.upper };
+    dictionary optimal;
+    STATS_CLOCK(solve);
+    if (engine == ENGINE_IPM)
+        optimal = interior_point(&p.c, &p.b, &p.a, p.sense, p.lower ? &vb : 0, ctx, out);
+    else if (engine == ENGINE_REVISED)
+        optimal = revised_simplex(&p.c, &p.b, &p.a, p.sense, p.lower ? &vb : 0, start.varc ? &start : 0, ctx, out);
+    else if (start.varc)
+        optimal = simplex_warm(&p.c, &p.b, &p.a, p.sense, p.lower ? &vb : 0, &start, ctx, out);
+    else
+        optimal = simplex(&p.c, &p.b, &p.a, p.sense, p.lower ? &vb : 0, ctx, out);
+    STATS_TIME(solve, solve);
+    optimal.post = reduced ? &post : 0;
+    optimal.scale = scaling_opts.enabled ? &scale : 0;
+    print_solution(&optimal);
+#ifdef SIMPLEX_STATS
+    if (stats_output)
+        print_stats(out, path, 0, &optimal, engine, p.b.size, p.vars, p.a.nnz, now() - begin);
+#endif
+    freebasis(&start);
+
+    // Save the final basis
+    if (warm_opts.save) {
+        basis final = save_basis(&optimal);
+        if (optimal.varc != p.c.size || !write_basis(&final, warm_opts.save))
+            wr_printf(out, "Failed to save the basis to: %s\n", warm_opts.save);
+        freebasis(&final);
+    }
+
+    // Solve the scenarios on the same constraints
+    if (p.scen.count > 0)
+        solve_scenarios(path, &p, &optimal, scaling_opts.enabled ? &scale : 0, engine, out);
+
+    // Cleanup
+    freedic(&optimal);
+    freelp(&p);
+    if (reduced) {
+        freelp(&original);
+        freepost(&post);
+    }
+    if (scaling_opts.enabled)
+        freescaling(&scale);
+
+}
+
+// Convert a problem file to the binary format, returns the exit code.
+int convert_file(const char* path, const char* binaryPath) {
+    linprog p = read_model(path);
+    if (p.max == -1) {
+        fprintf(stderr, "Failed to read program file: %s\n", path);
+        return 1;
+    }
+    if (p.scen.count > 0) {
+        fprintf(stderr, "The binary format has no scenarios, '%s' was not converted.\n", path);
+        freelp(&p);
+        return 1;
+    }
+    int ok = write_binary(&p, binaryPath);
+    if (!ok)
+        fprintf(stderr, "Failed to write '%s'.\n", binaryPath);
+    freelp(&p);
+    return ok ? 0 : 1;
+}
+
+// A problem file solved as part of a batch
+typedef struct {
+    const char* path; // The problem file
+    writer out; // The output of the problem, kept in memory until it is its turn to be printed
+    int done; // Set once the problem is solved
+} job;
+
+// A batch of problem files solved concurrently
+typedef struct {
+    job* jobs; // The problems in input order
+    int count; // The amount of problems
+    int next; // The next problem to solve
+    int printed; // The next problem to print
+    int engine; // The engine every problem is solved with (ENGINE_*)
+    int level; // The verbosity level
+#ifdef SIMPLEX_THREADS
+    pthread_mutex_t lock; // Guards next, printed and the done flags
+#endif
+} batch;
+
+void batch_lock(batch* b) {
+#ifdef SIMPLEX_THREADS
+    pthread_mutex_lock(&b->lock);
+#endif
+}
+
+void batch_unlock(batch* b) {
+#ifdef SIMPLEX_THREADS
+    pthread_mutex_unlock(&b->lock);
+#endif
+}
+
+// Pool task solving problems until none are left, every thread reuses its own solver context.
+// Finished output is written in input order by whichever thread completes the next problem in line.
+void batch_worker(void* arg, int block, int begin, int end) {
+    batch* b = (batch*)arg;
+    (void)block, (void)begin, (void)end;
+    simplex_context ctx = context(0);
+    for (;;) {
+
+        // Take the next problem
+        batch_lock(b);
+        int i = b->next++;
+        batch_unlock(b);
+        if (i >= b->count)
+            break;
+
+        // Solve it into its own buffer
+        job* j = &b->jobs[i];
+        j->out = wr(0, b->level);
+        solve_file(j->path, b->engine, &ctx, &j->out);
+
+        // Print every finished problem that is next in line
+        batch_lock(b);
+        j->done = 1;
+        while (b->printed < b->count && b->jobs[b->printed].done) {
+            job* p = &b->jobs[b->printed++];
+            fwrite(p->out.data, 1, p->out.size, stdout);
+            freewr(&p->out);
+        }
+        batch_unlock(b);
+
+    }
+    freecontext(&ctx);
+}
+
+#ifndef SIMPLEX_NO_MAIN
+int main(int argc, char** args) {
+    
+    // Read options, the remaining arguments are moved to the front as problem files
+    const char* kernel = "auto";
+    int engine = ENGINE_TABLEAU;
+    int threads = 0;
+    int level = VERBOSITY_NORMAL;
+    int jobs = 1;
+    int files = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(args[i], "-q") == 0) {
+            level = VERBOSITY_QUIET;
+        } else if (strcmp(args[i], "-v") == 0) {
+            level = VERBOSITY_NORMAL;
+        } else if (strcmp(args[i], "-vv") == 0) {
+            level = VERBOSITY_TRACE;
+        } else if (strcmp(args[i], "--kernel") == 0 && i + 1 < argc) {
+            kernel = args[++i];
+        } else if (strcmp(args[i], "--engine") == 0 && i + 1 < argc) {
+            i++;
+            engine = -1;
+            for (int e = ENGINE_TABLEAU; e <= ENGINE_IPM; e++)
+                if (strcmp(args[i], engine_names[e]) == 0)
+                    engine = e;
+            if (engine == -1) {
+                fprintf(stderr, "Unknown engine '%s' (allowed: tableau, revised, ipm)\n", args[i]);
+                return 1;
+            }
+        } else if (strcmp(args[i], "--pricing") == 0 && i + 1 < argc) {
+            if (!select_pricing(args[++i])) {
+                fprintf(stderr, "Unknown pricing rule '%s' (allowed: dantzig, devex, steepest)\n", args[i]);
+                return 1;
+            }
+        } else if (strcmp(args[i], "--partial") == 0 && i + 1 < argc) {
+            pricing_opts.window = atoi(args[++i]);
+        } else if (strcmp(args[i], "--candidates") == 0 && i + 1 < argc) {
+            pricing_opts.candidates = atoi(args[++i]);
+        } else if (strcmp(args[i], "--stall") == 0 && i + 1 < argc) {
+            degeneracy_opts.stall = atoi(args[++i]);
+        } else if (strcmp(args[i], "--perturb") == 0 && i + 1 < argc) {
+            degeneracy_opts.perturb = atof(args[++i]);
+        } else if (strcmp(args[i], "--max-iterations") == 0 && i + 1 < argc) {
+            degeneracy_opts.maxIterations = atol(args[++i]);
+        } else if (strcmp(args[i], "--harris") == 0) {
+            tolerance_opts.harris = 1;
+        } else if (strcmp(args[i], "--primal-tol") == 0 && i + 1 < argc) {
+            tolerance_opts.primal = atof(args[++i]);
+        } else if (strcmp(args[i], "--pivot-tol") == 0 && i + 1 < argc) {
+            tolerance_opts.pivot = atof(args[++i]);
+        } else if (strcmp(args[i], "--basis") == 0 && i + 1 < argc) {
+            warm_opts.load = args[++i];
+        } else if (strcmp(args[i], "--save-basis") == 0 && i + 1 < argc) {
+            warm_opts.save = args[++i];
+        } else if (strcmp(args[i], "--method") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(args[i], "auto") == 0) {
+                simplex_method = METHOD_AUTO;
+            } else if (strcmp(args[i], "primal") == 0) {
+                simplex_method = METHOD_PRIMAL;
+            } else if (strcmp(args[i], "dual") == 0) {
+                simplex_method = METHOD_DUAL;
+            } else {
+                fprintf(stderr, "Unknown method '%s' (allowed: auto, primal, dual)\n", args[i]);
+                return 1;
+            }
+        } else if (strcmp(args[i], "--scale") == 0) {
+            scaling_opts.enabled = 1;
+        } else if (strcmp(args[i], "--presolve") == 0) {
+            presolve_opts.enabled = 1;
+        } else if (strcmp(args[i], "--stats") == 0) {
+#ifdef SIMPLEX_STATS
+            stats_output = 1;
+#else
+            fprintf(stderr, "Statistics are not compiled in, build with -DSIMPLEX_STATS\n");
+            return 1;
+#endif
+        } else if (strcmp(args[i], "--convert") == 0 && i + 2 < argc) {
+            return convert_file(args[i + 1], args[i + 2]);
+        } else if (strcmp(args[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs = atoi(args[++i]);
+        } else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(args[++i]);
+        } else if (strcmp(args[i], "--mt-threshold") == 0 && i + 1 < argc) {
+            pool.threshold = atol(args[++i]);
+        } else if (args[i][0] == '-' && args[i][1] == '-') {
+            fprintf(stderr, "Unknown or incomplete option '%s'\n", args[i]);
+            return 1;
+        } else {
+            args[++files] = args[i];
+        }
+    }
+
+    // Pick the pivot kernel
+    if (!select_kernel(kernel)) {
+        fprintf(stderr, "Pivot kernel '%s' is not available (allowed: auto, scalar, sse2, avx2)\n", kernel);
+        return 1;
+    }
+
+    // Print usage if no problem files are provided
+    if (files == 0) {
+        printf("No problem file supplied in arguments.\n");
+        return 0;
+    }
+
+    // Solve several files at once, every file on a single thread
+    if (jobs != 1 && files > 1) {
+        pool_start(jobs);
+        pool.threshold = LONG_MAX; // Pivots inside a job never use the pool
+        batch b;
+        b.jobs = (job*)calloc(files, sizeof(job));
+        b.count = files;
+        b.next = 0;
+        b.printed = 0;
+        b.engine = engine;
+        b.level = level;
+        for (int i = 0; i < files; i++)
+            b.jobs[i].path = args[i + 1];
+#ifdef SIMPLEX_THREADS
+        pthread_mutex_init(&b.lock, 0);
+#endif
+        pool_run(batch_worker, &b, pool.threads, LONG_MAX);
+#ifdef SIMPLEX_THREADS
+        pthread_mutex_destroy(&b.lock);
+#endif
+        free(b.jobs);
+        fflush(stdout);
+        pool_stop();
+        return 0;
+    }
+
+    // Start the worker threads used by large pivots
+    pool_start(threads);
+
+    // All output goes through one buffered writer, and every problem reuses the memory of one context
+    writer out = wr(stdout, level);
+    simplex_context ctx = context(0);
+
+    // Read over all inputs
+    for (int i = 1; i <= files; i++)
+        solve_file(args[i], engine, &ctx, &out);
+
+    // Write remaining output and stop worker threads
+    freecontext(&ctx);
+    freewr(&out);
+    pool_stop();
 
     // Return OK
     return 0;
 
 }
+#endif